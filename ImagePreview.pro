@@ -5,7 +5,8 @@
 #-------------------------------------------------
 
 QT       += core gui \
-    printsupport
+    printsupport \
+    concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -25,7 +26,27 @@ SOURCES += main.cpp\
     restoretrashdialog.cpp \
     cursormanager.cpp \
     helpdialog.cpp \
-    exifparser.cpp
+    exifparser.cpp \
+    imagedecoder.cpp \
+    imageprefetcher.cpp \
+    imagecache.cpp \
+    directoryindex.cpp \
+    directoryscanner.cpp \
+    tiledimageitem.cpp \
+    tiffreader.cpp \
+    imageorientation.cpp \
+    psdreader.cpp \
+    paralleldecoder.cpp \
+    thumbnailcache.cpp \
+    thumbnailmodel.cpp \
+    thumbnailview.cpp \
+    batchconverter.cpp \
+    commandlineconverter.cpp \
+    resampler.cpp \
+    targetsizeencoder.cpp \
+    orientationwriter.cpp \
+    savequeue.cpp \
+    copyengine.cpp
 
 HEADERS  += mainwindow.h \
     graphicsscene.h \
@@ -37,7 +58,27 @@ HEADERS  += mainwindow.h \
     restoretrashdialog.h \
     cursormanager.h \
     helpdialog.h \
-    exifparser.h
+    exifparser.h \
+    imagedecoder.h \
+    imageprefetcher.h \
+    imagecache.h \
+    directoryindex.h \
+    directoryscanner.h \
+    tiledimageitem.h \
+    tiffreader.h \
+    imageorientation.h \
+    psdreader.h \
+    paralleldecoder.h \
+    thumbnailcache.h \
+    thumbnailmodel.h \
+    thumbnailview.h \
+    batchconverter.h \
+    commandlineconverter.h \
+    resampler.h \
+    targetsizeencoder.h \
+    orientationwriter.h \
+    savequeue.h \
+    copyengine.h
 
 FORMS    += mainwindow.ui \
     convertimagesdialog.ui \
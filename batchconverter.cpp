@@ -0,0 +1,359 @@
+#include "batchconverter.h"
+#include "imagecache.h"
+#include "imagedecoder.h"
+#include "resampler.h"
+#include "targetsizeencoder.h"
+
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSettings>
+#include <QThread>
+
+namespace {
+
+//first stage, runs on a thread of the pool
+class DecodeJob : public QRunnable
+{
+public:
+    DecodeJob(QObject *receiver, int index, QString path, QSize maxSize, ImageCache *cache,
+              QSharedPointer<QAtomicInt> cancelled) :
+        receiver(receiver), index(index), path(path), maxSize(maxSize), cache(cache), cancelled(cancelled)
+    {
+    }
+
+    void run() {
+        QElapsedTimer timer;
+        timer.start();
+
+        //images the viewer has decoded at full resolution are taken from its cache,
+        //the others are not added to it, they would only push out the viewer's images
+        //the decoder reduces large images to maxSize right away, the resampler
+        //is only needed for cached and animated images
+        ImageDecoder decoder;
+        if(!cache || !cache->find(path, decoder, maxSize)) {
+            decoder = ImageDecoder(path, maxSize);
+            decoder.setCancelFlag(cancelled);
+            decoder.decode();
+        }
+
+        QImage image = decoder.getImage();
+        if(maxSize.isValid() && (image.width() > maxSize.width() || image.height() > maxSize.height()))
+            image = Resampler::resize(image, image.size().scaled(maxSize, Qt::KeepAspectRatio));
+
+        QMetaObject::invokeMethod(receiver, "imageDecoded", Qt::QueuedConnection,
+                                  Q_ARG(int, index), Q_ARG(QImage, image),
+                                  Q_ARG(QString, decoder.getErrorString()),
+                                  Q_ARG(qint64, timer.elapsed()), Q_ARG(qint64, QFileInfo(path).size()));
+    }
+
+private:
+    QObject *receiver;
+    int index;
+    QString path;
+    QSize maxSize;
+    ImageCache *cache;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+//second stage, writes the new file in one go so a cancelled or failed
+//conversion doesn't leave a partial file behind
+class EncodeJob : public QRunnable
+{
+public:
+    EncodeJob(QObject *receiver, int index, QImage image, QString path, QString format, int quality,
+              qint64 targetBytes, QSharedPointer<QAtomicInt> cancelled) :
+        receiver(receiver), index(index), image(image), path(path), format(format), quality(quality),
+        targetBytes(targetBytes), cancelled(cancelled)
+    {
+    }
+
+    void run() {
+        QElapsedTimer timer;
+        timer.start();
+
+        const qint64 imageBytes = image.sizeInBytes();
+        QString errorString;
+        qint64 bytes = 0;
+        int iterations = 0;
+
+        if(cancelled->loadRelaxed()) {
+            errorString = "Cancelled";
+        }
+        else {
+            QSaveFile file(path);
+            QImageWriter writer(&file, format.toLatin1());
+            writer.setQuality(quality);
+
+            //with a target size the file is written from the best candidate in memory
+            TargetSizeEncoder encoder(format.toLatin1(), targetBytes);
+            const bool targetSize = targetBytes > 0 && TargetSizeEncoder::supportsFormat(format.toLatin1());
+
+            if(!file.open(QIODevice::WriteOnly)) {
+                errorString = file.errorString();
+            }
+            else if(targetSize && !encoder.encode(image)) {
+                errorString = encoder.getErrorString();
+                file.cancelWriting();
+            }
+            else if(targetSize && file.write(encoder.getData()) != encoder.getData().size()) {
+                errorString = file.errorString();
+                file.cancelWriting();
+            }
+            else if(!targetSize && !writer.write(image)) {
+                errorString = writer.errorString();
+                file.cancelWriting();
+            }
+            else if(!file.commit()) {
+                errorString = file.errorString();
+            }
+            else {
+                bytes = QFileInfo(path).size();
+            }
+
+            if(targetSize) {
+                quality = encoder.getQuality();
+                iterations = encoder.getIterations();
+
+                //the file is still written, at the lowest quality
+                if(errorString.isEmpty() && !encoder.isWithinTarget())
+                    errorString = "Larger than the target size even at quality 1";
+            }
+        }
+
+        //the image is not needed anymore, its memory counts against the budget until it is released
+        image = QImage();
+
+        QMetaObject::invokeMethod(receiver, "imageEncoded", Qt::QueuedConnection,
+                                  Q_ARG(int, index), Q_ARG(QString, errorString),
+                                  Q_ARG(qint64, timer.elapsed()), Q_ARG(qint64, bytes),
+                                  Q_ARG(qint64, imageBytes), Q_ARG(int, quality), Q_ARG(int, iterations));
+    }
+
+private:
+    QObject *receiver;
+    int index;
+    QImage image;
+    QString path;
+    QString format;
+    int quality;
+    qint64 targetBytes;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+}
+
+BatchConverter::BatchConverter(QObject *parent) :
+    QObject(parent)
+{
+    QSettings qsettings( "simon", "imagepreview" );
+    memoryBudget = qsettings.value( "convert/memoryBudgetMB", 1024 ).toLongLong() * 1024 * 1024;
+
+    format = "jpg";
+    quality = -1;
+    targetBytes = 0;
+    imageCache = 0;
+    cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    nextIndex = 0;
+    runningJobs = 0;
+    finishedCount = 0;
+    failedCount = 0;
+    pendingBytes = 0;
+    inputBytes = 0;
+    elapsed = 0;
+
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+BatchConverter::~BatchConverter() {
+    //the jobs post their results to this object
+    cancel();
+    pool.waitForDone();
+}
+
+//the format of the new files, also their suffix (without the dot)
+void BatchConverter::setFormat(QString format) {
+    this->format = format;
+}
+
+//quality of the encoder, -1 for its default
+void BatchConverter::setQuality(int quality) {
+    this->quality = quality;
+}
+
+//the highest quality at which each file has at most this size is searched for
+//(JPEG and WebP only), 0 to use the fixed quality
+void BatchConverter::setTargetSize(qint64 bytes) {
+    targetBytes = bytes;
+}
+
+//appended to the name of the original file
+void BatchConverter::setNameSuffix(QString suffix) {
+    nameSuffix = suffix;
+}
+
+//larger images are reduced so their longer side has this many pixels, 0 keeps the size
+void BatchConverter::setMaxDimension(int pixels) {
+    maxSize = pixels > 0 ? QSize(pixels, pixels) : QSize();
+}
+
+void BatchConverter::setThreadCount(int count) {
+    pool.setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+}
+
+//limit for the decoded images that wait for the encoder. Each running decoder may add one
+//more image on top, so the memory in use stays below budget + threads * largest image
+void BatchConverter::setMemoryBudget(qint64 bytes) {
+    memoryBudget = bytes;
+}
+
+//the cache of the viewer, images that are in it are not decoded again
+void BatchConverter::setImageCache(ImageCache *cache) {
+    imageCache = cache;
+}
+
+QString BatchConverter::getOutputPath(QString path) const {
+    QFileInfo fileInfo(path);
+    return fileInfo.path() + "/" + fileInfo.baseName() + nameSuffix + "." + format;
+}
+
+//converts the files in the background, fileFinished() is emitted for each of them
+//and finished() once all of them are done or the conversion was cancelled
+void BatchConverter::start(QStringList paths) {
+    if(isRunning())
+        return;
+
+    results.clear();
+    for(const QString &path : paths) {
+        Result result;
+        result.path = path;
+        result.outputPath = getOutputPath(path);
+        result.decodeTime = 0;
+        result.encodeTime = 0;
+        result.inputBytes = 0;
+        result.outputBytes = 0;
+        result.quality = quality;
+        result.iterations = 0;
+        result.done = false;
+        results.append(result);
+    }
+
+    cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    nextIndex = 0;
+    finishedCount = 0;
+    failedCount = 0;
+    pendingBytes = 0;
+    inputBytes = 0;
+    elapsed = 0;
+    timer.start();
+
+    schedule();
+}
+
+//no new files are started, running decoders stop early. Files that
+//were not finished are not written, finished() follows soon after
+void BatchConverter::cancel() {
+    cancelled->storeRelaxed(1);
+}
+
+bool BatchConverter::isRunning() const {
+    return runningJobs > 0;
+}
+
+bool BatchConverter::isCancelled() const {
+    return cancelled->loadRelaxed();
+}
+
+const BatchConverter::Result& BatchConverter::getResult(int index) const {
+    return results.at(index);
+}
+
+int BatchConverter::getFileCount() const {
+    return results.size();
+}
+
+int BatchConverter::getFinishedCount() const {
+    return finishedCount;
+}
+
+int BatchConverter::getFailedCount() const {
+    return failedCount;
+}
+
+double BatchConverter::getFilesPerSecond() const {
+    const qint64 time = isRunning() ? timer.elapsed() : elapsed;
+    return time > 0 ? finishedCount * 1000.0 / time : 0.0;
+}
+
+//megabytes of original files read per second
+double BatchConverter::getMegabytesPerSecond() const {
+    const qint64 time = isRunning() ? timer.elapsed() : elapsed;
+    return time > 0 ? inputBytes / 1000.0 / time : 0.0;
+}
+
+//starts decoding further files while there is memory for their images. Decoders
+//only run on threads that are not needed by the encoder, which has a higher priority
+void BatchConverter::schedule() {
+    while(!isCancelled() && nextIndex < results.size() && pendingBytes < memoryBudget
+          && runningJobs < pool.maxThreadCount()) {
+        pool.start(new DecodeJob(this, nextIndex, results.at(nextIndex).path, maxSize, imageCache, cancelled), 0);
+        nextIndex++;
+        runningJobs++;
+    }
+
+    if(runningJobs == 0) {
+        elapsed = timer.elapsed();
+        emit finished();
+    }
+}
+
+void BatchConverter::finishFile(int index, QString errorString) {
+    Result &result = results[index];
+    result.errorString = errorString;
+    result.done = true;
+
+    finishedCount++;
+    if(!errorString.isEmpty())
+        failedCount++;
+
+    emit fileFinished(index);
+}
+
+void BatchConverter::imageDecoded(int index, QImage image, QString errorString, qint64 time, qint64 bytes) {
+    runningJobs--;
+
+    Result &result = results[index];
+    result.decodeTime = time;
+    result.inputBytes = bytes;
+    inputBytes += bytes;
+
+    if(isCancelled()) {
+        finishFile(index, "Cancelled");
+    }
+    else if(image.isNull()) {
+        finishFile(index, errorString.isEmpty() ? "Could not decode the image" : errorString);
+    }
+    else {
+        pendingBytes += image.sizeInBytes();
+        pool.start(new EncodeJob(this, index, image, result.outputPath, format, quality, targetBytes, cancelled), 1);
+        runningJobs++;
+    }
+
+    schedule();
+}
+
+void BatchConverter::imageEncoded(int index, QString errorString, qint64 time, qint64 bytes, qint64 imageBytes,
+                                  int quality, int iterations) {
+    runningJobs--;
+    pendingBytes -= imageBytes;
+
+    Result &result = results[index];
+    result.encodeTime = time;
+    result.outputBytes = bytes;
+    result.quality = quality;
+    result.iterations = iterations;
+
+    finishFile(index, errorString);
+    schedule();
+}
@@ -0,0 +1,104 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QSharedPointer>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+class ImageCache;
+
+//converts images into another format on all cores. Every file passes two
+//stages on the worker threads: it is decoded, then encoded into a file next
+//to the original. Encoding is preferred over decoding so decoded images
+//don't pile up, and no new file is decoded while the images that wait for
+//the encoder take more memory than the budget.
+//The converter needs an event loop, but no GUI, so it is also used by the
+//command line mode.
+class BatchConverter : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchConverter(QObject *parent = 0);
+    ~BatchConverter();
+    void setFormat(QString format);
+    void setQuality(int quality);
+    void setTargetSize(qint64 bytes);
+    void setNameSuffix(QString suffix);
+    void setMaxDimension(int pixels);
+    void setThreadCount(int count);
+    void setMemoryBudget(qint64 bytes);
+    void setImageCache(ImageCache *cache);
+    QString getOutputPath(QString path) const;
+    void start(QStringList paths);
+    void cancel();
+    bool isRunning() const;
+    bool isCancelled() const;
+
+    //what happened to one file, the times are in milliseconds
+    struct Result {
+        QString path;
+        QString outputPath;
+        //empty if the file was converted
+        QString errorString;
+        qint64 decodeTime;
+        qint64 encodeTime;
+        qint64 inputBytes;
+        qint64 outputBytes;
+        //the quality that was used, with a target size the one that was found
+        int quality;
+        //rounds of the target size search, 0 without a target size
+        int iterations;
+        bool done;
+    };
+
+    const Result& getResult(int index) const;
+    int getFileCount() const;
+    int getFinishedCount() const;
+    int getFailedCount() const;
+    double getFilesPerSecond() const;
+    double getMegabytesPerSecond() const;
+
+signals:
+    void fileFinished(int index);
+    void finished();
+
+private:
+    QString format;
+    int quality;
+    qint64 targetBytes;
+    QString nameSuffix;
+    //invalid if the images keep their size
+    QSize maxSize;
+    qint64 memoryBudget;
+    ImageCache *imageCache;
+    QThreadPool pool;
+    QSharedPointer<QAtomicInt> cancelled;
+    QVector<Result> results;
+    //the next file that is decoded
+    int nextIndex;
+    int runningJobs;
+    int finishedCount;
+    int failedCount;
+    //decoded images that are queued for the encoder or being encoded
+    qint64 pendingBytes;
+    qint64 inputBytes;
+    QElapsedTimer timer;
+    qint64 elapsed;
+
+    void schedule();
+    void finishFile(int index, QString errorString);
+
+private slots:
+    void imageDecoded(int index, QImage image, QString errorString, qint64 time, qint64 bytes);
+    void imageEncoded(int index, QString errorString, qint64 time, qint64 bytes, qint64 imageBytes,
+                      int quality, int iterations);
+};
+
+#endif // BATCHCONVERTER_H
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Builds a benchmark against two revisions of the sources and runs both with
+# the same arguments, e.g. to compare the code before and after a change:
+#   benchmarks/compare.sh exifparser be3333b HEAD ~/Pictures 5
+# The benchmark itself is always taken from the working tree.
+
+if [ $# -lt 3 ]; then
+    echo "usage: $0 <benchmark> <before revision> <after revision> [benchmark arguments]"
+    exit 1
+fi
+
+BENCHMARK=$1
+BEFORE=$2
+AFTER=$3
+shift 3
+
+REPO=$(git rev-parse --show-toplevel) || exit 1
+WORK=$(mktemp -d)
+QMAKE=${QMAKE:-qmake6}
+
+# the worktrees are removed when a build or run fails too
+cleanup() {
+    for TREE in "$WORK"/*; do
+        [ -d "$TREE" ] && git -C "$REPO" worktree remove --force "$TREE"
+    done
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+for REVISION in "$BEFORE" "$AFTER"; do
+    TREE="$WORK/$(git -C "$REPO" rev-parse --short "$REVISION")" || exit 1
+    git -C "$REPO" worktree add --quiet --detach "$TREE" "$REVISION" > /dev/null || exit 1
+    mkdir -p "$TREE/benchmarks"
+    rm -rf "$TREE/benchmarks/$BENCHMARK"
+    cp -r "$REPO/benchmarks/$BENCHMARK" "$TREE/benchmarks/"
+
+    (cd "$TREE/benchmarks/$BENCHMARK" && $QMAKE > /dev/null && make -j "$(nproc)" > /dev/null) || exit 1
+
+    echo "== $REVISION ($(git -C "$REPO" log -1 --format=%s "$REVISION"))"
+    "$TREE/benchmarks/$BENCHMARK/$BENCHMARK-benchmark" "$@"
+    echo
+done
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Measures how long ExifParser takes per file.
+# Usage: exifparser-benchmark <folder with jpegs> [iterations]
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = exifparser-benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../exifparser.cpp
+
+HEADERS  += ../../exifparser.h
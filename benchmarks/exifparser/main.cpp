@@ -0,0 +1,65 @@
+#include "exifparser.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <iostream>
+
+//parses every JPEG in a folder (and its subfolders) a few times and prints
+//the average time per file. The first pass is not measured, so the files
+//are in the page cache and only the parser itself is timed.
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    if(arguments.size() < 2) {
+        std::cerr << "usage: exifparser-benchmark <folder with jpegs> [iterations]" << std::endl;
+        return 1;
+    }
+
+    const int iterations = arguments.size() > 2 ? qMax(1, arguments.at(2).toInt()) : 5;
+
+    QList<QUrl> urls;
+    QDirIterator it(arguments.at(1), QStringList() << "*.jpg" << "*.jpeg" << "*.JPG" << "*.JPEG",
+                    QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+        urls.append(QUrl::fromLocalFile(it.next()));
+
+    if(urls.isEmpty()) {
+        std::cerr << "no jpegs found" << std::endl;
+        return 1;
+    }
+
+    //warm up, also counts the results so the parser can't be optimized away
+    int valid = 0;
+    int rotated = 0;
+    for(const QUrl &url : urls) {
+        ExifParser parser(url);
+        if(parser.isValidExifData())
+            valid++;
+        if(parser.getOrientation() != 1)
+            rotated++;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int checksum = 0;
+    for(int i = 0; i < iterations; ++i) {
+        for(const QUrl &url : urls) {
+            ExifParser parser(url);
+            checksum += parser.getOrientation();
+        }
+    }
+
+    const qint64 nanoseconds = timer.nsecsElapsed();
+    const double perFile = (double)nanoseconds / iterations / urls.size() / 1000.0;
+
+    std::cout << urls.size() << " files, " << valid << " with EXIF data, " << rotated << " rotated" << std::endl;
+    std::cout << iterations << " iterations in " << nanoseconds / 1000000 << " ms" << std::endl;
+    std::cout << perFile << " us per file (checksum " << checksum << ")" << std::endl;
+
+    return 0;
+}
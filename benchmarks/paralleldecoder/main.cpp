@@ -0,0 +1,86 @@
+#include "paralleldecoder.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QThread>
+#include <QThreadPool>
+
+#include <iostream>
+
+//decodes the image a few times with QImageReader and then with
+//ParallelDecoder using 1, 2, 4, ... threads up to the number of cores,
+//and prints the average latency and the speedup over QImageReader.
+//The first decode is not measured, so the file is in the page cache.
+static double measure(const QString &path, int iterations, bool parallel, int &segments) {
+    QElapsedTimer timer;
+    qint64 nanoseconds = 0;
+
+    for(int i = 0; i <= iterations; ++i) {
+        timer.start();
+
+        QImage image;
+        if(parallel) {
+            ParallelDecoder decoder(path);
+            image = decoder.read();
+            segments = decoder.getSegmentCount();
+            if(image.isNull()) {
+                std::cerr << "can't decode in parallel: " << decoder.getErrorString().toStdString() << std::endl;
+                return -1;
+            }
+        }
+        else {
+            QImageReader reader(path);
+            reader.setAllocationLimit(0);
+            image = reader.read();
+            if(image.isNull()) {
+                std::cerr << "can't decode: " << reader.errorString().toStdString() << std::endl;
+                return -1;
+            }
+        }
+
+        if(i > 0)
+            nanoseconds += timer.nsecsElapsed();
+    }
+
+    return (double)nanoseconds / iterations / 1000000.0;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    if(arguments.size() < 2) {
+        std::cerr << "usage: paralleldecoder-benchmark <image> [iterations]" << std::endl;
+        return 1;
+    }
+
+    const QString path = arguments.at(1);
+    const int iterations = arguments.size() > 2 ? qMax(1, arguments.at(2).toInt()) : 3;
+    const QSize size = QImageReader(path).size();
+    std::cout << path.toStdString() << ": " << size.width() << "x" << size.height() << std::endl;
+
+    int segments = 0;
+    const double reference = measure(path, iterations, false, segments);
+    if(reference < 0)
+        return 1;
+
+    std::cout << "QImageReader: " << reference << " ms" << std::endl;
+
+    const int cores = QThread::idealThreadCount();
+    for(int threads = 1; ; threads = qMin(threads * 2, cores)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+        const double latency = measure(path, iterations, true, segments);
+        if(latency < 0)
+            return 1;
+
+        std::cout << threads << " threads, " << segments << " segments: " << latency << " ms, "
+                  << reference / latency << "x" << std::endl;
+
+        if(threads == cores)
+            break;
+    }
+
+    return 0;
+}
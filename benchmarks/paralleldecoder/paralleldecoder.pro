@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Measures how long a single image takes to decode, by Qt's reader and
+# by ParallelDecoder with an increasing number of threads.
+# Usage: paralleldecoder-benchmark <image> [iterations]
+#
+#-------------------------------------------------
+
+QT       += core gui \
+    concurrent
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = paralleldecoder-benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../paralleldecoder.cpp \
+    ../../tiffreader.cpp
+
+HEADERS  += ../../paralleldecoder.h \
+    ../../tiffreader.h
@@ -0,0 +1,210 @@
+#include "commandlineconverter.h"
+#include "targetsizeencoder.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+
+#include <stdio.h>
+
+CommandLineConverter::CommandLineConverter(QObject *parent) :
+    QObject(parent),
+    out(stdout),
+    err(stderr)
+{
+    connect(&converter, SIGNAL(fileFinished(int)), this, SLOT(fileFinished(int)));
+    connect(&converter, SIGNAL(finished()), this, SLOT(finished()));
+}
+
+//sets up the converter, prints the problem and returns false if the arguments are invalid
+bool CommandLineConverter::parse(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts images without opening a window.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("convert", "Run the batch conversion."));
+    parser.addOption(QCommandLineOption(QStringList() << "f" << "format", "Format of the new files: jpg, png, tif, ppm, bmp, xpm or webp.", "format", "jpg"));
+    parser.addOption(QCommandLineOption(QStringList() << "q" << "quality", "Quality of the encoder, 1 to 100.", "quality", "98"));
+    parser.addOption(QCommandLineOption(QStringList() << "s" << "suffix", "Appended to the names of the new files.", "suffix", "_converted"));
+    parser.addOption(QCommandLineOption(QStringList() << "t" << "target-size", "Highest quality at which each file has at most this many kB (jpg and webp).", "kB", "0"));
+    parser.addOption(QCommandLineOption(QStringList() << "m" << "max-size", "Larger images are reduced to this many pixels on their longer side.", "pixels", "0"));
+    parser.addOption(QCommandLineOption(QStringList() << "j" << "jobs", "Number of worker threads, all cores by default.", "count", "0"));
+    parser.addOption(QCommandLineOption(QStringList() << "l" << "list", "File with one image path per line, - for stdin.", "file"));
+    parser.addPositionalArgument("images", "Image paths or wildcard patterns like \"shoot/*.jpg\".", "[images...]");
+
+    if(!parser.parse(arguments)) {
+        err << parser.errorText() << Qt::endl;
+        return false;
+    }
+
+    if(parser.isSet("help"))
+        parser.showHelp(0);
+
+    bool validQuality;
+    const int quality = parser.value("quality").toInt(&validQuality);
+    bool validJobs;
+    const int jobs = parser.value("jobs").toInt(&validJobs);
+    bool validMaxSize;
+    const int maxSize = parser.value("max-size").toInt(&validMaxSize);
+    bool validTargetSize;
+    const qint64 targetSize = parser.value("target-size").toLongLong(&validTargetSize);
+    if(!validQuality || quality < 1 || quality > 100 || !validJobs || jobs < 0 || !validMaxSize || maxSize < 0
+            || !validTargetSize || targetSize < 0) {
+        err << "Invalid quality, number of jobs, maximum or target size" << Qt::endl;
+        return false;
+    }
+
+    const QString format = parser.value("format").toLower();
+    if(!QStringList({"jpg", "png", "tif", "ppm", "bmp", "xpm", "webp"}).contains(format)
+            || !QImageWriter::supportedImageFormats().contains(format.toLatin1())) {
+        err << "Unsupported format: " << format << Qt::endl;
+        return false;
+    }
+
+    if(targetSize > 0 && !TargetSizeEncoder::supportsFormat(format.toLatin1())) {
+        err << "A target size needs jpg or webp" << Qt::endl;
+        return false;
+    }
+
+    converter.setFormat(format);
+    converter.setQuality(quality);
+    converter.setTargetSize(targetSize * 1000);
+    converter.setNameSuffix(parser.value("suffix"));
+    converter.setThreadCount(jobs);
+    converter.setMaxDimension(maxSize);
+
+    bool valid = true;
+    for(const QString &argument : parser.positionalArguments()) {
+        const bool pattern = argument.contains('*') || argument.contains('?') || argument.contains('[');
+        valid &= pattern ? addGlob(argument) : addPath(argument);
+    }
+
+    for(const QString &listPath : parser.values("list"))
+        valid &= addList(listPath);
+
+    if(paths.isEmpty()) {
+        err << "No images to convert" << Qt::endl;
+        return false;
+    }
+
+    return valid;
+}
+
+void CommandLineConverter::start() {
+    printHeader();
+    converter.start(paths);
+}
+
+//0 if every file was converted
+int CommandLineConverter::getExitCode() const {
+    return converter.getFailedCount() > 0 ? 1 : 0;
+}
+
+//true if the application was started with --convert
+bool CommandLineConverter::isRequested(int argc, char *argv[]) {
+    for(int i = 1; i < argc; i++) {
+        if(qstrcmp(argv[i], "--convert") == 0)
+            return true;
+    }
+
+    return false;
+}
+
+//the whole command line mode, returns the exit code of the process
+int CommandLineConverter::run(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+
+    CommandLineConverter commandLineConverter;
+    if(!commandLineConverter.parse(application.arguments()))
+        return 2;
+
+    QObject::connect(&commandLineConverter, SIGNAL(done()), &application, SLOT(quit()), Qt::QueuedConnection);
+    commandLineConverter.start();
+    application.exec();
+
+    return commandLineConverter.getExitCode();
+}
+
+//status, decode and encode time in milliseconds, size of the original and the new
+//file in bytes, the quality and the iterations of the target size search (0 without
+//a target size), path of the original and the new file
+void CommandLineConverter::printHeader() {
+    out << "#status\tdecode_ms\tencode_ms\tinput_bytes\toutput_bytes\tquality\titerations\tpath\toutput_path" << Qt::endl;
+}
+
+bool CommandLineConverter::addPath(QString path) {
+    QFileInfo fileInfo(path);
+    if(!fileInfo.isFile()) {
+        err << "Not a file: " << path << Qt::endl;
+        return false;
+    }
+
+    paths.append(fileInfo.absoluteFilePath());
+    return true;
+}
+
+//the wildcards may only be used in the file name, the shell usually expands them anyway
+bool CommandLineConverter::addGlob(QString pattern) {
+    QFileInfo fileInfo(pattern);
+    const QFileInfoList files = QDir(fileInfo.path()).entryInfoList(QStringList(fileInfo.fileName()), QDir::Files, QDir::Name);
+
+    if(files.isEmpty()) {
+        err << "No files match: " << pattern << Qt::endl;
+        return false;
+    }
+
+    for(const QFileInfo &file : files)
+        paths.append(file.absoluteFilePath());
+
+    return true;
+}
+
+bool CommandLineConverter::addList(QString listPath) {
+    QFile file(listPath);
+    bool opened;
+    if(listPath == "-")
+        opened = file.open(stdin, QIODevice::ReadOnly | QIODevice::Text);
+    else
+        opened = file.open(QIODevice::ReadOnly | QIODevice::Text);
+
+    if(!opened) {
+        err << "Could not read " << listPath << ": " << file.errorString() << Qt::endl;
+        return false;
+    }
+
+    bool valid = true;
+    QTextStream stream(&file);
+    while(!stream.atEnd()) {
+        const QString line = stream.readLine().trimmed();
+        if(!line.isEmpty())
+            valid &= addPath(line);
+    }
+
+    return valid;
+}
+
+void CommandLineConverter::fileFinished(int index) {
+    const BatchConverter::Result &result = converter.getResult(index);
+
+    out << (result.errorString.isEmpty() ? "ok" : "error") << '\t'
+        << result.decodeTime << '\t' << result.encodeTime << '\t'
+        << result.inputBytes << '\t' << result.outputBytes << '\t'
+        << result.quality << '\t' << result.iterations << '\t'
+        << result.path << '\t' << result.outputPath << Qt::endl;
+
+    if(!result.errorString.isEmpty())
+        err << result.path << ": " << result.errorString << Qt::endl;
+}
+
+void CommandLineConverter::finished() {
+    err << QString("%1 of %2 images converted, %3 failed, %4 files/s, %5 MB/s")
+           .arg(converter.getFinishedCount() - converter.getFailedCount())
+           .arg(converter.getFileCount())
+           .arg(converter.getFailedCount())
+           .arg(converter.getFilesPerSecond(), 0, 'f', 1)
+           .arg(converter.getMegabytesPerSecond(), 0, 'f', 1) << Qt::endl;
+
+    emit done();
+}
@@ -0,0 +1,45 @@
+#ifndef COMMANDLINECONVERTER_H
+#define COMMANDLINECONVERTER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTextStream>
+#include "batchconverter.h"
+
+//runs a BatchConverter without a window, for scripts and build servers:
+//  ImagePreview --convert -f png -q 90 -s _web -m 2048 -t 500 -j 8 "shoot/*.jpg" --list more.txt
+//Every converted file is printed to stdout as one line of tab separated
+//fields (see printHeader()), the summary goes to stderr.
+class CommandLineConverter : public QObject
+{
+    Q_OBJECT
+
+public:
+    CommandLineConverter(QObject *parent = 0);
+    bool parse(const QStringList &arguments);
+    void start();
+    int getExitCode() const;
+
+    static bool isRequested(int argc, char *argv[]);
+    static int run(int argc, char *argv[]);
+
+private:
+    BatchConverter converter;
+    QStringList paths;
+    QTextStream out;
+    QTextStream err;
+
+    void printHeader();
+    bool addPath(QString path);
+    bool addGlob(QString pattern);
+    bool addList(QString listPath);
+
+private slots:
+    void fileFinished(int index);
+    void finished();
+
+signals:
+    void done();
+};
+
+#endif // COMMANDLINECONVERTER_H
@@ -1,6 +1,7 @@
 #include "convertimagesdialog.h"
 #include "ui_convertimagesdialog.h"
-#include <QFileInfo>
+#include <QCloseEvent>
+#include <QImageWriter>
 
 ConvertImagesDialog::ConvertImagesDialog(QWidget *parent, ImageHandler *imageHandler, QList<QUrl> urls) :
     QDialog(parent),
@@ -9,10 +10,20 @@ ConvertImagesDialog::ConvertImagesDialog(QWidget *parent, ImageHandler *imageHan
     imageHandler(imageHandler)
 {
     ui->setupUi(this);
+
+    //only offered if Qt's image formats plugin is installed
+    if(QImageWriter::supportedImageFormats().contains("webp"))
+        ui->comboBox_format->addItem(".webp");
     
     connect(ui->pushButton_convert, SIGNAL(clicked()), this, SLOT(convert()));
-    connect(ui->comboBox_format, SIGNAL(currentIndexChanged(QString)), this, SLOT(setQualityOptions(QString)));
-    connect(ui->pushButton_cancel, SIGNAL(clicked()), this, SLOT(close()));
+    connect(ui->comboBox_format, SIGNAL(currentTextChanged(QString)), this, SLOT(setQualityOptions(QString)));
+    connect(ui->checkBox_targetSize, SIGNAL(toggled(bool)), this, SLOT(updateQualityOptions()));
+    connect(ui->pushButton_cancel, SIGNAL(clicked()), this, SLOT(reject()));
+    connect(&converter, SIGNAL(fileFinished(int)), this, SLOT(fileConverted(int)));
+    connect(&converter, SIGNAL(finished()), this, SLOT(conversionFinished()));
+
+    //the options of the format that is selected in the form
+    setQualityOptions(ui->comboBox_format->currentText());
 }
 
 ConvertImagesDialog::~ConvertImagesDialog()
@@ -20,35 +31,136 @@ ConvertImagesDialog::~ConvertImagesDialog()
     delete ui;
 }
 
+//the images are converted in the background, the dialog stays responsive
 void ConvertImagesDialog::convert() {
+    if(converter.isRunning())
+        return;
+
+    QStringList paths;
+    for(const QUrl &url : images)
+        paths.append(url.toLocalFile());
+
+    //the format is chosen with its suffix
+    converter.setFormat(ui->comboBox_format->currentText().mid(1));
+    converter.setQuality(ui->spinBox_jpgQuality->value());
+    converter.setTargetSize(isTargetSizeUsed() ? (qint64)ui->spinBox_targetSize->value() * 1000 : 0);
+    converter.setNameSuffix(ui->lineEdit_nameSuffix->text());
+    converter.setMaxDimension(ui->spinBox_maxDimension->value());
+
+    //images that were viewed at full resolution are usually still in the cache
+    if(imageHandler)
+        converter.setImageCache(imageHandler->getImageCache());
+
+    ui->plainTextEdit_log->clear();
+    ui->plainTextEdit_log->hide();
+    ui->progressBar->setMaximum(qMax(1, paths.size()));
     ui->progressBar->setValue(0);
-    double percentageBase = 100.0 / images.size();
-    
-    for(int i = 0; i < images.size(); i++) {
-        ui->progressBar->setValue((int)(percentageBase) * (i + 1));
-        
-        QUrl url = images.at(i);
-        
-        QFileInfo fileInfo(url.toLocalFile());
-        
-        QString newFilePath = fileInfo.path();
-        QString newFileName = fileInfo.baseName() + ui->lineEdit_nameSuffix->text();
-        QString newFileSuffix = ui->comboBox_format->currentText();
-        
-        QString savePath = newFilePath + "/" + newFileName + newFileSuffix;
-        
-        QImage image(url.toLocalFile());
-        image.save(savePath, 0, ui->spinBox_jpgQuality->value());
+    setInputsEnabled(false);
+
+    converter.start(paths);
+}
+
+void ConvertImagesDialog::fileConverted(int index) {
+    const BatchConverter::Result &result = converter.getResult(index);
+
+    if(!result.errorString.isEmpty() && !converter.isCancelled()) {
+        ui->plainTextEdit_log->appendPlainText(result.path + ": " + result.errorString);
+        ui->plainTextEdit_log->show();
     }
-    
-    ui->progressBar->setValue(100);
-    
-    close();
+    else if(result.errorString.isEmpty() && result.iterations > 0) {
+        //the quality that was found for the target size
+        ui->plainTextEdit_log->appendPlainText(QString("%1: quality %2 after %3 iterations, %4 kB")
+                                               .arg(result.path)
+                                               .arg(result.quality)
+                                               .arg(result.iterations)
+                                               .arg(result.outputBytes / 1000.0, 0, 'f', 1));
+        ui->plainTextEdit_log->show();
+    }
+
+    ui->progressBar->setValue(converter.getFinishedCount());
+    updateStatus();
+}
+
+void ConvertImagesDialog::conversionFinished() {
+    ui->progressBar->setValue(ui->progressBar->maximum());
+    setInputsEnabled(true);
+    updateStatus();
+
+    //the errors and chosen qualities stay visible
+    if(!converter.isCancelled() && converter.getFailedCount() == 0 && !isTargetSizeUsed())
+        close();
+}
+
+//throughput of the conversion so far
+void ConvertImagesDialog::updateStatus() {
+    QString status = QString("%1 of %2 images, %3 files/s, %4 MB/s")
+            .arg(converter.getFinishedCount())
+            .arg(converter.getFileCount())
+            .arg(converter.getFilesPerSecond(), 0, 'f', 1)
+            .arg(converter.getMegabytesPerSecond(), 0, 'f', 1);
+
+    if(converter.getFailedCount() > 0)
+        status += QString(", %1 failed").arg(converter.getFailedCount());
+
+    if(converter.isCancelled() && !converter.isRunning())
+        status += ", cancelled";
+
+    ui->label_status->setText(status);
+}
+
+void ConvertImagesDialog::setInputsEnabled(bool enabled) {
+    ui->lineEdit_nameSuffix->setEnabled(enabled);
+    ui->comboBox_format->setEnabled(enabled);
+    ui->spinBox_maxDimension->setEnabled(enabled);
+    ui->pushButton_convert->setEnabled(enabled);
+
+    if(enabled) {
+        updateQualityOptions();
+    }
+    else {
+        ui->spinBox_jpgQuality->setEnabled(false);
+        ui->checkBox_targetSize->setEnabled(false);
+        ui->spinBox_targetSize->setEnabled(false);
+    }
+}
+
+//only JPEG and WebP files get smaller with a lower quality
+bool ConvertImagesDialog::hasQualityOption() const {
+    const QString format = ui->comboBox_format->currentText();
+    return format == ".jpg" || format == ".webp";
+}
+
+bool ConvertImagesDialog::isTargetSizeUsed() const {
+    return hasQualityOption() && ui->checkBox_targetSize->isChecked();
+}
+
+//cancels a running conversion, the dialog is only closed when nothing is running
+void ConvertImagesDialog::reject() {
+    if(converter.isRunning()) {
+        converter.cancel();
+        return;
+    }
+
+    QDialog::reject();
+}
+
+void ConvertImagesDialog::closeEvent(QCloseEvent *event) {
+    converter.cancel();
+    QDialog::closeEvent(event);
 }
 
 void ConvertImagesDialog::setQualityOptions(QString format) {
-    bool isJpg = (format == ".jpg");
-    
-    ui->label_jpgQuality->setEnabled(isJpg);
-    ui->spinBox_jpgQuality->setEnabled(isJpg);
+    Q_UNUSED(format);
+    updateQualityOptions();
+}
+
+//the fixed quality is not used with a target size
+void ConvertImagesDialog::updateQualityOptions() {
+    const bool hasQuality = hasQualityOption();
+    const bool targetSize = isTargetSizeUsed();
+
+    ui->label_jpgQuality->setEnabled(hasQuality && !targetSize);
+    ui->spinBox_jpgQuality->setEnabled(hasQuality && !targetSize);
+    ui->checkBox_targetSize->setEnabled(hasQuality);
+    ui->spinBox_targetSize->setEnabled(targetSize);
 }
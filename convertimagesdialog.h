@@ -3,6 +3,7 @@
 
 #include <QDialog>
 #include "imagehandler.h"
+#include "batchconverter.h"
 
 namespace Ui {
 class ConvertImagesDialog;
@@ -21,10 +22,25 @@ private:
     Ui::ConvertImagesDialog *ui;
     QList<QUrl> images;
     ImageHandler *imageHandler;
+    BatchConverter converter;
+
+    void setInputsEnabled(bool enabled);
+    void updateStatus();
+    bool hasQualityOption() const;
+    bool isTargetSizeUsed() const;
+
+protected:
+    void closeEvent(QCloseEvent *event);
+
+public slots:
+    void reject();
     
 private slots:
     void convert();
     void setQualityOptions(QString format);
+    void updateQualityOptions();
+    void fileConverted(int index);
+    void conversionFinished();
     
 };
 
@@ -0,0 +1,339 @@
+#include "copyengine.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+namespace {
+
+//bytes per request, small enough for the progress and for cancelling
+const qint64 chunkSize = 16 * 1024 * 1024;
+const qint64 bufferSize = 1024 * 1024;
+
+//runs on a thread of the pool
+class CopyJob : public QRunnable
+{
+public:
+    CopyJob(QObject *receiver, int index, QString path, QString targetPath,
+            QSharedPointer<QAtomicInt> cancelled) :
+        receiver(receiver), index(index), path(path), targetPath(targetPath), cancelled(cancelled)
+    {
+    }
+
+    void run() {
+        qint64 copied = 0;
+        const QString errorString = copy(copied);
+
+        QMetaObject::invokeMethod(receiver, "fileCopied", Qt::QueuedConnection,
+                                  Q_ARG(int, index), Q_ARG(QString, errorString), Q_ARG(qint64, copied));
+    }
+
+private:
+    QObject *receiver;
+    int index;
+    QString path;
+    QString targetPath;
+    QSharedPointer<QAtomicInt> cancelled;
+
+    QString copy(qint64 &copied) {
+        if(cancelled->loadRelaxed())
+            return "Cancelled";
+
+        //like QFile::copy(), existing files are not replaced
+        if(QFileInfo::exists(targetPath))
+            return "The file already exists";
+
+        QFile source(path);
+        if(!source.open(QIODevice::ReadOnly))
+            return source.errorString();
+
+        QSaveFile target(targetPath);
+        if(!target.open(QIODevice::WriteOnly))
+            return target.errorString();
+
+        const qint64 size = source.size();
+        QString errorString = copyData(source, target, size, copied);
+
+        //size() flushes the buffer of the block copy
+        if(errorString.isEmpty() && target.size() != size)
+            errorString = "The copy has " + QString::number(target.size()) + " instead of "
+                    + QString::number(size) + " bytes";
+
+        if(!errorString.isEmpty()) {
+            target.cancelWriting();
+            return errorString;
+        }
+
+        //file browsers that sort by date keep the order of the originals
+        target.setPermissions(source.permissions());
+        target.setFileTime(source.fileTime(QFileDevice::FileModificationTime), QFileDevice::FileModificationTime);
+
+        if(!target.commit())
+            return target.errorString();
+
+        return QString();
+    }
+
+    QString copyData(QFile &source, QSaveFile &target, qint64 size, qint64 &copied) {
+#ifdef Q_OS_LINUX
+        const int in = source.handle();
+        const int out = target.handle();
+
+#ifdef FICLONE
+        //a reflink shares the blocks of the source, nothing is copied (Btrfs, XFS)
+        if(ioctl(out, FICLONE, in) == 0) {
+            copied = size;
+            reportProgress(size);
+            return QString();
+        }
+#endif
+
+        //the kernel copies without going through this process, it may also use
+        //reflinks or server side copies (NFS, SMB) by itself
+        while(copied < size) {
+            if(cancelled->loadRelaxed())
+                return "Cancelled";
+
+            const ssize_t bytes = copy_file_range(in, 0, out, 0, qMin(chunkSize, size - copied), 0);
+            if(bytes < 0) {
+                //not supported between these file systems, the copy below is used
+                if(copied == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+                    break;
+
+                return QString::fromLocal8Bit(strerror(errno));
+            }
+
+            //the source got shorter, the size check fails
+            if(bytes == 0)
+                return QString();
+
+            copied += bytes;
+            reportProgress(bytes);
+        }
+
+        if(copied > 0 || size == 0)
+            return QString();
+#endif
+
+        QByteArray buffer;
+        buffer.resize(bufferSize);
+        while(copied < size) {
+            if(cancelled->loadRelaxed())
+                return "Cancelled";
+
+            const qint64 bytes = source.read(buffer.data(), qMin(bufferSize, size - copied));
+            if(bytes < 0)
+                return source.errorString();
+
+            if(bytes == 0)
+                return QString();
+
+            if(target.write(buffer.constData(), bytes) != bytes)
+                return target.errorString();
+
+            copied += bytes;
+            reportProgress(bytes);
+        }
+
+        return QString();
+    }
+
+    void reportProgress(qint64 bytes) {
+        QMetaObject::invokeMethod(receiver, "bytesCopied", Qt::QueuedConnection, Q_ARG(qint64, bytes));
+    }
+};
+
+}
+
+CopyEngine::CopyEngine(QObject *parent) :
+    QObject(parent)
+{
+    QSettings qsettings( "simon", "imagepreview" );
+    setQueueDepth(qsettings.value( "copy/queueDepth", 4 ).toInt());
+
+    cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    nextIndex = 0;
+    runningJobs = 0;
+    finishedCount = 0;
+    failedCount = 0;
+    totalBytes = 0;
+    copiedBytes = 0;
+    runBytes = 0;
+    elapsed = 0;
+}
+
+CopyEngine::~CopyEngine() {
+    //the jobs post their results to this object
+    cancel();
+    pool.waitForDone();
+}
+
+//number of files that are copied at the same time. SSDs need several
+//requests at once to reach their speed, hard disks are faster with few
+void CopyEngine::setQueueDepth(int depth) {
+    pool.setMaxThreadCount(qBound(1, depth, 64));
+}
+
+//copies the files into the folder, fileFinished() is emitted for each of them
+//and finished() once all of them are done or the copy was cancelled
+void CopyEngine::start(QStringList paths, QString targetDirectory) {
+    if(isRunning())
+        return;
+
+    results.clear();
+    totalBytes = 0;
+    finishedCount = 0;
+    failedCount = 0;
+    copiedBytes = 0;
+
+    //files from different folders can have the same name. The jobs run at
+    //the same time, so the existing file check can't see the other copy and
+    //the later commit would replace it, only the first one is copied
+    QSet<QString> targetPaths;
+    for(const QString &path : paths) {
+        const QFileInfo fileInfo(path);
+
+        Result result;
+        result.path = path;
+        result.targetPath = QDir(targetDirectory).filePath(fileInfo.fileName());
+        result.bytes = 0;
+        result.done = false;
+
+        if(targetPaths.contains(result.targetPath)) {
+            result.errorString = "Another file with this name is copied too";
+            result.done = true;
+            finishedCount++;
+            failedCount++;
+        }
+        else {
+            targetPaths.insert(result.targetPath);
+            totalBytes += fileInfo.size();
+        }
+
+        results.append(result);
+    }
+
+    resume();
+}
+
+//continues after cancel() with the files that were not finished, files that
+//could not be copied are not tried again
+void CopyEngine::resume() {
+    if(isRunning())
+        return;
+
+    cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    nextIndex = 0;
+    runBytes = 0;
+    elapsed = 0;
+    timer.start();
+    progressTimer.start();
+
+    schedule();
+}
+
+//no new files are started, the running ones stop at their next block and
+//are removed. finished() follows soon after
+void CopyEngine::cancel() {
+    cancelled->storeRelaxed(1);
+}
+
+bool CopyEngine::isRunning() const {
+    return runningJobs > 0;
+}
+
+bool CopyEngine::isCancelled() const {
+    return cancelled->loadRelaxed();
+}
+
+const CopyEngine::Result& CopyEngine::getResult(int index) const {
+    return results.at(index);
+}
+
+int CopyEngine::getFileCount() const {
+    return results.size();
+}
+
+int CopyEngine::getFinishedCount() const {
+    return finishedCount;
+}
+
+int CopyEngine::getFailedCount() const {
+    return failedCount;
+}
+
+qint64 CopyEngine::getTotalBytes() const {
+    return totalBytes;
+}
+
+qint64 CopyEngine::getCopiedBytes() const {
+    return copiedBytes;
+}
+
+double CopyEngine::getMegabytesPerSecond() const {
+    const qint64 time = isRunning() ? timer.elapsed() : elapsed;
+    return time > 0 ? runBytes / 1000.0 / time : 0.0;
+}
+
+//keeps as many files in progress as the queue depth allows
+void CopyEngine::schedule() {
+    while(!isCancelled() && nextIndex < results.size() && runningJobs < pool.maxThreadCount()) {
+        const Result &result = results.at(nextIndex);
+        if(!result.done) {
+            pool.start(new CopyJob(this, nextIndex, result.path, result.targetPath, cancelled));
+            runningJobs++;
+        }
+        nextIndex++;
+    }
+
+    if(runningJobs == 0) {
+        elapsed = timer.elapsed();
+        emit finished();
+    }
+}
+
+void CopyEngine::bytesCopied(qint64 bytes) {
+    copiedBytes += bytes;
+    runBytes += bytes;
+
+    if(progressTimer.elapsed() >= 100) {
+        progressTimer.restart();
+        emit progress();
+    }
+}
+
+void CopyEngine::fileCopied(int index, QString errorString, qint64 bytes) {
+    runningJobs--;
+
+    if(errorString == "Cancelled") {
+        //the partial copy was removed, the file is copied again by resume()
+        copiedBytes -= bytes;
+        runBytes -= bytes;
+    }
+    else {
+        Result &result = results[index];
+        result.errorString = errorString;
+        result.bytes = bytes;
+        result.done = true;
+
+        finishedCount++;
+        if(!errorString.isEmpty())
+            failedCount++;
+
+        emit fileFinished(index);
+    }
+
+    schedule();
+}
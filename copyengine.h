@@ -0,0 +1,84 @@
+#ifndef COPYENGINE_H
+#define COPYENGINE_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+//copies files into a folder in the background, several at once so fast
+//drives get enough requests to stay busy (queue depth, the setting
+//copy/queueDepth). On Linux the file system is asked for a reflink first,
+//then the kernel copies with copy_file_range(), other systems and file
+//systems read and write in blocks. Every file is written to a temporary
+//file that only gets its name once its size was checked, a cancelled copy
+//leaves nothing behind and resume() continues with the files that were
+//not finished. Existing files are never replaced, neither are files with
+//the same name as one earlier in the list.
+class CopyEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    CopyEngine(QObject *parent = 0);
+    ~CopyEngine();
+    void setQueueDepth(int depth);
+    void start(QStringList paths, QString targetDirectory);
+    void resume();
+    bool isRunning() const;
+    bool isCancelled() const;
+
+    struct Result {
+        QString path;
+        QString targetPath;
+        //empty if the file was copied
+        QString errorString;
+        qint64 bytes;
+        bool done;
+    };
+
+    const Result& getResult(int index) const;
+    int getFileCount() const;
+    int getFinishedCount() const;
+    int getFailedCount() const;
+    qint64 getTotalBytes() const;
+    qint64 getCopiedBytes() const;
+    double getMegabytesPerSecond() const;
+
+public slots:
+    void cancel();
+
+signals:
+    //emitted while the files are copied, at most 10 times per second
+    void progress();
+    void fileFinished(int index);
+    void finished();
+
+private:
+    QThreadPool pool;
+    QSharedPointer<QAtomicInt> cancelled;
+    QVector<Result> results;
+    //the next file that is started
+    int nextIndex;
+    int runningJobs;
+    int finishedCount;
+    int failedCount;
+    qint64 totalBytes;
+    qint64 copiedBytes;
+    //since start() or resume(), for the throughput
+    qint64 runBytes;
+    QElapsedTimer timer;
+    qint64 elapsed;
+    QElapsedTimer progressTimer;
+
+    void schedule();
+
+private slots:
+    void bytesCopied(qint64 bytes);
+    void fileCopied(int index, QString errorString, qint64 bytes);
+};
+
+#endif // COPYENGINE_H
@@ -0,0 +1,340 @@
+#include "directoryindex.h"
+#include "directoryscanner.h"
+#include "imagedecoder.h"
+
+#include <QPair>
+
+#include <algorithm>
+
+DirectoryIndex::DirectoryIndex(QObject *parent) :
+    QObject(parent)
+{
+    fileQueue = false;
+    scanning = false;
+    rescanPending = false;
+    scanner = 0;
+
+    //same order as the DirectoryScanner
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    //directories that are being written to (e.g. by a renderer) report
+    //lots of changes in a short time, only scan once they calm down
+    rescanTimer.setSingleShot(true);
+    rescanTimer.setInterval(250);
+
+    connect(&watcher, SIGNAL(directoryChanged(QString)), &rescanTimer, SLOT(start()));
+    connect(&rescanTimer, SIGNAL(timeout()), this, SLOT(rescan()));
+}
+
+DirectoryIndex::~DirectoryIndex() {
+    if(scanner) {
+        disconnect(scanner, 0, this, 0);
+        scanner->requestInterruption();
+        scanner->wait();
+        delete scanner;
+    }
+}
+
+//starts listing the directory if it is not the one that is already indexed.
+//current is navigable right away, the other files follow in batches.
+void DirectoryIndex::setDirectory(QUrl url, QUrl current) {
+    if(!fileQueue && url == directory)
+        return;
+
+    stopScanner();
+    rescanTimer.stop();
+    if(!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+
+    directory = url;
+    fileQueue = false;
+
+    paths.clear();
+    pinnedPath = current.toLocalFile();
+    if(!pinnedPath.isEmpty())
+        paths.append(pinnedPath);
+    rebuildPositions();
+
+    watcher.addPath(directory.toLocalFile());
+    startScanner();
+
+    emit listReplaced();
+    emit changed();
+}
+
+//uses a fixed list of files instead of a directory
+void DirectoryIndex::setFiles(QList<QUrl> files) {
+    stopScanner();
+    rescanTimer.stop();
+    if(!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+
+    directory = QUrl();
+    fileQueue = true;
+    pinnedPath.clear();
+
+    paths.clear();
+    for(const QUrl &url : files) {
+        paths.append(url.toLocalFile());
+    }
+    rebuildPositions();
+
+    emit listReplaced();
+    emit changed();
+}
+
+bool DirectoryIndex::isFileQueue() const {
+    return fileQueue;
+}
+
+//true while the initial listing of a directory is still running
+bool DirectoryIndex::isScanning() const {
+    return scanning;
+}
+
+QUrl DirectoryIndex::getDirectory() const {
+    return directory;
+}
+
+int DirectoryIndex::size() const {
+    return paths.size();
+}
+
+//returns -1 if the url is not in the index
+int DirectoryIndex::indexOf(QUrl url) const {
+    return positions.value(url.toLocalFile(), -1);
+}
+
+QUrl DirectoryIndex::at(int index) const {
+    if(index < 0 || index >= paths.size())
+        return QUrl();
+
+    return QUrl::fromLocalFile(paths.at(index));
+}
+
+//returns the url offset entries away from index, wrapping around at both ends
+QUrl DirectoryIndex::neighbour(int index, int offset) const {
+    if(paths.isEmpty())
+        return QUrl();
+
+    int neighbourIndex = (index + offset) % paths.size();
+    if(neighbourIndex < 0)
+        neighbourIndex += paths.size();
+
+    return QUrl::fromLocalFile(paths.at(neighbourIndex));
+}
+
+void DirectoryIndex::remove(QUrl url) {
+    int index = indexOf(url);
+    if(index < 0)
+        return;
+
+    removePaths(QStringList() << paths.at(index));
+
+    emit changed();
+}
+
+QStringList DirectoryIndex::getNameFilter() {
+    QStringList nameFilter;
+    nameFilter << "*.png" << "*.jpg" << "*.jpeg" << "*.tiff" << "*.tif"
+               << "*.ppm" << "*.bmp" << "*.xpm" << "*.psd" << "*.psb" << "*.gif";
+
+    //displayed by their embedded preview
+    for(const QString &suffix : ImageDecoder::getRawSuffixes())
+        nameFilter << "*." + suffix;
+
+    return nameFilter;
+}
+
+void DirectoryIndex::startScanner() {
+    stopScanner();
+
+    scanning = true;
+    scanner = new DirectoryScanner(directory.toLocalFile(), getNameFilter());
+    connect(scanner, SIGNAL(filesFound(QStringList,bool)), this, SLOT(scannerFilesFound(QStringList,bool)));
+    connect(scanner, SIGNAL(finished()), scanner, SLOT(deleteLater()));
+    scanner->start(QThread::LowPriority);
+}
+
+//abandons the running scan, the thread deletes itself when it stops
+void DirectoryIndex::stopScanner() {
+    if(!scanner)
+        return;
+
+    disconnect(scanner, 0, this, 0);
+    scanner->requestInterruption();
+    scanner = 0;
+    scanning = false;
+    rescanPending = false;
+}
+
+//merges sortedPaths into the list, positions only change behind the first new path
+void DirectoryIndex::insertPaths(const QStringList &sortedPaths) {
+    QStringList merged;
+    merged.reserve(paths.size() + sortedPaths.size());
+    QList<QPair<int, int> > ranges;
+
+    QStringList::const_iterator from = paths.constBegin();
+    for(const QString &path : sortedPaths) {
+        if(positions.contains(path))
+            continue;
+
+        QStringList::const_iterator to = std::lower_bound(from, paths.constEnd(), path,
+                                                          [this](const QString &a, const QString &b) {
+            return isBefore(a, b);
+        });
+        for(; from != to; ++from) {
+            merged.append(*from);
+        }
+
+        const int index = merged.size();
+        merged.append(path);
+        if(!ranges.isEmpty() && ranges.last().second == index - 1)
+            ranges.last().second = index;
+        else
+            ranges.append(qMakePair(index, index));
+    }
+
+    if(ranges.isEmpty())
+        return;
+
+    for(; from != paths.constEnd(); ++from) {
+        merged.append(*from);
+    }
+
+    paths.swap(merged);
+    rebuildPositions(ranges.first().first);
+
+    for(const QPair<int, int> &range : ranges) {
+        emit filesInserted(range.first, range.second);
+    }
+}
+
+//compacts the list in one pass, positions only change behind the first removed path
+void DirectoryIndex::removePaths(const QStringList &removedPaths) {
+    QList<int> removed;
+    for(const QString &path : removedPaths) {
+        const int index = positions.value(path, -1);
+        if(index < 0)
+            continue;
+
+        removed.append(index);
+        positions.remove(path);
+        if(path == pinnedPath)
+            pinnedPath.clear();
+    }
+
+    if(removed.isEmpty())
+        return;
+
+    std::sort(removed.begin(), removed.end());
+
+    QStringList remaining;
+    remaining.reserve(paths.size() - removed.size());
+    int next = 0;
+    for(int i = 0; i < paths.size(); ++i) {
+        if(next < removed.size() && removed.at(next) == i)
+            ++next;
+        else
+            remaining.append(paths.at(i));
+    }
+
+    paths.swap(remaining);
+    rebuildPositions(removed.first());
+
+    //from the back, so the rows in front of a range keep their numbers
+    int last = removed.size() - 1;
+    while(last >= 0) {
+        int first = last;
+        while(first > 0 && removed.at(first - 1) == removed.at(first) - 1) {
+            --first;
+        }
+
+        emit filesRemoved(removed.at(first), removed.at(last));
+        last = first - 1;
+    }
+}
+
+//natural order of the file names, like the DirectoryScanner
+bool DirectoryIndex::isBefore(const QString &a, const QString &b) const {
+    return collator.compare(a.mid(a.lastIndexOf('/') + 1), b.mid(b.lastIndexOf('/') + 1)) < 0;
+}
+
+void DirectoryIndex::rebuildPositions(int from) {
+    if(from == 0)
+        positions.clear();
+
+    positions.reserve(paths.size());
+    for(int i = from; i < paths.size(); ++i) {
+        positions.insert(paths.at(i), i);
+    }
+}
+
+//called when the watched directory changed on disk
+void DirectoryIndex::rescan() {
+    if(fileQueue || !directory.isValid())
+        return;
+
+    //don't restart a listing that is still running, scan again when it is done
+    if(scanner) {
+        rescanPending = true;
+        return;
+    }
+
+    scanner = new DirectoryScanner(directory.toLocalFile(), getNameFilter());
+    scanner->setKnownPaths(paths);
+    connect(scanner, SIGNAL(filesChanged(QStringList,QStringList)), this, SLOT(scannerFilesChanged(QStringList,QStringList)));
+    connect(scanner, SIGNAL(finished()), scanner, SLOT(deleteLater()));
+    scanner->start(QThread::LowPriority);
+}
+
+void DirectoryIndex::scannerFilesFound(QStringList foundPaths, bool complete) {
+    if(sender() != scanner)
+        return;
+
+    //the opened file was in the list already, it is in its sorted place
+    if(!pinnedPath.isEmpty() && foundPaths.contains(pinnedPath))
+        pinnedPath.clear();
+
+    insertPaths(foundPaths);
+
+    if(complete) {
+        //the finished thread deletes itself
+        scanner = 0;
+        scanning = false;
+
+        //the opened file is gone
+        if(!pinnedPath.isEmpty())
+            removePaths(QStringList() << pinnedPath);
+
+        if(rescanPending) {
+            rescanPending = false;
+            rescanTimer.start();
+        }
+    }
+
+    emit changed();
+}
+
+//applies the difference found by a rescan, the rest of the list stays as it is
+void DirectoryIndex::scannerFilesChanged(QStringList added, QStringList removed) {
+    if(sender() != scanner)
+        return;
+
+    //the finished thread deletes itself
+    scanner = 0;
+
+    if(rescanPending) {
+        rescanPending = false;
+        rescanTimer.start();
+    }
+
+    if(added.isEmpty() && removed.isEmpty())
+        return;
+
+    removePaths(removed);
+    insertPaths(added);
+
+    emit changed();
+}
@@ -0,0 +1,77 @@
+#ifndef DIRECTORYINDEX_H
+#define DIRECTORYINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QUrl>
+#include <QStringList>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QCollator>
+
+class DirectoryScanner;
+
+//list of the images in a directory (or of a fixed file queue).
+//The directory is listed in the background and only scanned again when
+//the file system reports a change, lookups of positions are O(1).
+//Files that appear or vanish later are merged into the list and reported
+//by filesInserted()/filesRemoved() before changed(), a new directory or
+//file queue by listReplaced().
+class DirectoryIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    DirectoryIndex(QObject *parent = 0);
+    ~DirectoryIndex();
+    void setDirectory(QUrl url, QUrl current = QUrl());
+    void setFiles(QList<QUrl> files);
+    bool isFileQueue() const;
+    bool isScanning() const;
+    QUrl getDirectory() const;
+    int size() const;
+    int indexOf(QUrl url) const;
+    QUrl at(int index) const;
+    QUrl neighbour(int index, int offset) const;
+    void remove(QUrl url);
+
+    static QStringList getNameFilter();
+
+private:
+    QUrl directory;
+    //local file paths, in natural sort order for directories
+    QStringList paths;
+    QHash<QString, int> positions;
+    //file that was opened, in the list before the scanner finds it
+    QString pinnedPath;
+    bool fileQueue;
+    bool scanning;
+    bool rescanPending;
+    DirectoryScanner *scanner;
+    QFileSystemWatcher watcher;
+    QTimer rescanTimer;
+    QCollator collator;
+
+    void startScanner();
+    void stopScanner();
+    void insertPaths(const QStringList &sortedPaths);
+    void removePaths(const QStringList &removedPaths);
+    bool isBefore(const QString &a, const QString &b) const;
+    void rebuildPositions(int from = 0);
+
+private slots:
+    void rescan();
+    void scannerFilesFound(QStringList foundPaths, bool complete);
+    void scannerFilesChanged(QStringList added, QStringList removed);
+
+signals:
+    void changed();
+    void listReplaced();
+    //rows first to last of the current list, in ascending order
+    void filesInserted(int first, int last);
+    //rows first to last of the list before, in descending order
+    void filesRemoved(int first, int last);
+};
+
+#endif // DIRECTORYINDEX_H
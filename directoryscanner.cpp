@@ -0,0 +1,110 @@
+#include "directoryscanner.h"
+
+#include <QDirIterator>
+#include <QCollator>
+#include <QSet>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct ScannedFile {
+    QCollatorSortKey key;
+    QString path;
+
+    bool operator<(const ScannedFile &other) const {
+        return key.compare(other.key) < 0;
+    }
+};
+
+QStringList toPaths(const std::vector<ScannedFile> &files) {
+    QStringList paths;
+    paths.reserve((int)files.size());
+    for(const ScannedFile &file : files) {
+        paths.append(file.path);
+    }
+    return paths;
+}
+
+}
+
+DirectoryScanner::DirectoryScanner(QString path, QStringList nameFilter, QObject *parent) :
+    QThread(parent),
+    path(path),
+    nameFilter(nameFilter)
+{
+    rescan = false;
+
+    if(!this->path.endsWith("/"))
+        this->path += "/";
+}
+
+//reports filesChanged() instead of filesFound(), paths are the ones already indexed
+void DirectoryScanner::setKnownPaths(QStringList paths) {
+    knownPaths = paths;
+    rescan = true;
+}
+
+void DirectoryScanner::run() {
+    if(rescan) {
+        scanChanges();
+        return;
+    }
+
+    //sort keys are computed here, so comparing them later is cheap
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    std::vector<ScannedFile> batch;
+
+    //small first batch to show something quickly, growing batches keep
+    //the number of merges into the index at O(log n) for huge directories
+    int batchSize = 256;
+
+    QDirIterator it(path, nameFilter, QDir::Files);
+    while(it.hasNext()) {
+        if(isInterruptionRequested())
+            return;
+
+        it.next();
+        const QString name = it.fileName();
+        batch.push_back(ScannedFile{collator.sortKey(name), path + name});
+
+        if((int)batch.size() >= batchSize) {
+            std::sort(batch.begin(), batch.end());
+            emit filesFound(toPaths(batch), false);
+
+            batch.clear();
+            batchSize = qMin(batchSize * 2, 65536);
+        }
+    }
+
+    std::sort(batch.begin(), batch.end());
+    emit filesFound(toPaths(batch), true);
+}
+
+//only the new files are sorted, the index keeps its order for the others
+void DirectoryScanner::scanChanges() {
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    QSet<QString> missing(knownPaths.constBegin(), knownPaths.constEnd());
+    std::vector<ScannedFile> added;
+
+    QDirIterator it(path, nameFilter, QDir::Files);
+    while(it.hasNext()) {
+        if(isInterruptionRequested())
+            return;
+
+        it.next();
+        const QString filePath = path + it.fileName();
+        if(!missing.remove(filePath))
+            added.push_back(ScannedFile{collator.sortKey(it.fileName()), filePath});
+    }
+
+    std::sort(added.begin(), added.end());
+    emit filesChanged(toPaths(added), QStringList(missing.constBegin(), missing.constEnd()));
+}
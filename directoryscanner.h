@@ -0,0 +1,38 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QThread>
+#include <QStringList>
+
+//lists the images in a directory on a background thread, sorted in
+//natural order ("img2" before "img10"). Huge directories are reported
+//in growing batches so the first images can be shown right away.
+//With known paths set, only the files that were added or removed since
+//are reported, so a rescan doesn't sort the whole directory again.
+class DirectoryScanner : public QThread
+{
+    Q_OBJECT
+
+public:
+    DirectoryScanner(QString path, QStringList nameFilter, QObject *parent = 0);
+    void setKnownPaths(QStringList paths);
+
+protected:
+    void run();
+
+private:
+    QString path;
+    QStringList nameFilter;
+    QStringList knownPaths;
+    bool rescan;
+
+    void scanChanges();
+
+signals:
+    //paths contains the files found since the last report, sorted
+    void filesFound(QStringList paths, bool complete);
+    //added is sorted, removed contains known paths that are gone
+    void filesChanged(QStringList added, QStringList removed);
+};
+
+#endif // DIRECTORYSCANNER_H
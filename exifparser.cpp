@@ -1,240 +1,513 @@
 #include "exifparser.h"
 
-#include <QFile>
-#include <QDataStream>
-#include <QFileInfo>
-#include <iostream>
+#include <QList>
+#include <QPair>
+#include <QSet>
 
-ExifParser::ExifParser(QUrl imageUrl) {
-    this->imageUrl = imageUrl;
+#include <string.h>
+
+ExifParser::ExifParser(QUrl imageUrl) :
+    imageUrl(imageUrl),
+    file(imageUrl.toLocalFile())
+{
     format = MOTOROLA; //standard is big endian
-    orientation = 1; //default: top left
-
-    markerJpegStart = QByteArray::fromHex("FFD8");
-    markerExifStart = QByteArray::fromHex("FFE1");
-    exifCode = QByteArray::fromHex("457869660000");
-    intelFormatCode = QByteArray::fromHex("4949"); // little endian
-    motorolaFormatCode = QByteArray::fromHex("4D4D"); // big endian
-
-    //for now, only jpeg/jpg images are supported
-    QFileInfo fileInfo(imageUrl.toLocalFile());
-    if(fileInfo.suffix().toLower() != "jpg" && fileInfo.suffix().toLower() != "jpeg") {
-        //std::cout << "suffix not \"jpg\" or \"jpeg\". No EXIF data available." << std::endl;
-        isValid = false;
+    isValid = false;
+    tiff = 0;
+    tiffLength = 0;
+    tiffOffset = 0;
+    for(int i = 0; i < DIRECTORY_COUNT; ++i)
+        directories[i] = 0;
+
+    //unbuffered, only the few bytes that are needed are read
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
         return;
-    }
 
-    QFile file(imageUrl.toLocalFile());
-
-    if(!file.open(QIODevice::ReadOnly)) {
-        std::cerr << "could not open file" << std::endl;
-        isValid = false;
+    char signature[4];
+    if(file.read(signature, 4) != 4)
         return;
-    }
 
-    QDataStream input(&file);
-    QByteArray buffer;
-    const int length = 65536; //theoretical max size of jpeg header (bytes)
-
-    char temp[length];
-    input.readRawData(temp, length);
-    buffer.append(temp, length);
+    qint64 offset = 0;
+    quint32 length = 0;
+    if((uchar)signature[0] == 0xFF && (uchar)signature[1] == 0xD8) {
+        if(!findExifSegment(offset, length))
+            return;
+    }
+    else if(memcmp(signature, "II*\0", 4) == 0 || memcmp(signature, "MM\0*", 4) == 0) {
+        //the whole file is the TIFF structure, offsets are 32 bit
+        if(file.size() > 0xFFFFFFFFLL)
+            return;
 
-    //test if jpeg image is intact (2 bytes)
-    if(compareBytes(buffer, markerJpegStart, 0)) {
-        std::cout << "intact jpeg image" << std::endl;
+        length = file.size();
     }
     else {
-        std::cout << "not a jpeg image or corrupt image!" << std::endl;
-        isValid = false;
         return;
     }
 
-    //find exif begin marker FF-E1 (2 bytes)
-    exifStartPos = buffer.indexOf(markerExifStart);
-    std::cout << "EXIF marker found at: " << exifStartPos << std::endl;
+    tiff = file.map(offset, length);
 
-    //get length of exif data (2 bytes)
-    exifLengthPos = exifStartPos + 2;
-    exifLength = readUnsignedShort(buffer.mid(exifLengthPos, 2));
-    std::cout << "EXIF data is " << exifLength << " bytes long" << std::endl;
+    //the APP1 segment is at most 64 KB, TIFF based files are read in small
+    //parts by bytesAt() instead
+    if(!tiff && length <= 0xFFFF) {
+        if(!file.seek(offset))
+            return;
 
-    //check if it contains the code "Exif" (6 bytes)
-    exifCodePos = exifLengthPos + 2;
+        buffer = file.read(length);
+        if(buffer.size() != (int)length)
+            return;
 
-    if(compareBytes(buffer, exifCode, exifCodePos)) {
-        std::cout << "contains EXIF data" << std::endl;
-    }
-    else {
-        std::cout << "does not contain EXIF data" << std::endl;
-        isValid = false;
-        return;
+        tiff = reinterpret_cast<const uchar*>(buffer.constData());
     }
+    tiffLength = length;
+    tiffOffset = offset;
 
-    //now we are in the TIFF header (8 bytes)
-    tiffHeaderPos = exifCodePos + 6;
+    isValid = parseHeader();
+}
 
-    //check if intel or motorola format is used (2 bytes in TIFF header)
-    if(compareBytes(buffer, intelFormatCode, tiffHeaderPos)) {
-        std::cout << "intel format" << std::endl;
-        format = INTEL;
-    }
-    else if(compareBytes(buffer, motorolaFormatCode, tiffHeaderPos)) {
-        std::cout << "motorola format" << std::endl;
-        format = MOTOROLA;
-    }
+bool ExifParser::isValidExifData() const {
+    return isValid;
+}
 
-    //last 6 bytes of TIFF header contain always the same data, skip them
+unsigned short ExifParser::getOrientation() const {
+    const quint32 orientation = getUnsigned(IFD0, ORIENTATION, 1);
 
-    //now we are in the first image file directory (IDF)
-    //get amount of EXIF tags (2 bytes)
-    tagAmountPos = tiffHeaderPos + 8;
-    unsigned short tagAmount = readUnsignedShort(buffer.mid(tagAmountPos, 2));
-    std::cout << "tag amount: " << tagAmount << std::endl;
+    //default: top left
+    if(orientation < 1 || orientation > 8)
+        return 1;
 
-    //tags are always 12 bytes long, get their positions
-    tagPositions = std::vector<unsigned short>(tagAmount);
-    for(int i = 0; i < tagAmount; i++) {
-        tagPositions.at(i) = tagAmountPos + 2 + (i * 12);
-    }
+    return orientation;
+}
 
-    //read tags
-    for(int i = 0; i < tagAmount; i++) {
-        std::cout << "    tag " << i + 1 << ": " << readTag(tagPositions.at(i), buffer).toStdString() << std::endl;
-    }
+bool ExifParser::hasTag(Directory directory, quint16 tag) const {
+    return findEntry(directory, tag) != 0;
+}
+
+//number of values stored in the tag
+quint32 ExifParser::getCount(Directory directory, quint16 tag) const {
+    const uchar *entry = findEntry(directory, tag);
+    if(!entry)
+        return 0;
 
-    isValid = true;
+    return readUnsignedLong(entry + 4);
 }
 
-bool ExifParser::isValidExifData() {
-    return isValid;
+//value of a BYTE, SHORT or LONG tag
+quint32 ExifParser::getUnsigned(Directory directory, quint16 tag, quint32 defaultValue, quint32 index) const {
+    return entryUnsigned(findEntry(directory, tag), defaultValue, index);
 }
 
-unsigned short ExifParser::getOrientation() {
-    return orientation;
+//value of a RATIONAL or SRATIONAL tag, 0 if it is missing
+double ExifParser::getRational(Directory directory, quint16 tag, quint32 index) const {
+    quint32 count = 0;
+    quint16 type = 0;
+    const uchar *data = valueData(findEntry(directory, tag), count, type);
+    if(!data || index >= count || (type != 5 && type != 10))
+        return 0.0;
+
+    const quint32 numerator = readUnsignedLong(data + index * 8);
+    const quint32 denominator = readUnsignedLong(data + index * 8 + 4);
+    if(denominator == 0)
+        return 0.0;
+
+    if(type == 10)
+        return (double)(qint32)numerator / (qint32)denominator;
+
+    return (double)numerator / denominator;
 }
 
-bool ExifParser::compareBytes(QByteArray &source, QByteArray &comparison, int startIndex) {
-    for(int i = 0; i < comparison.size(); i++) {
-        if(source.at(startIndex + i) != comparison.at(i))
-            return false;
+//value of an ASCII tag
+QString ExifParser::getString(Directory directory, quint16 tag) const {
+    quint32 count = 0;
+    quint16 type = 0;
+    const uchar *data = valueData(findEntry(directory, tag), count, type);
+    if(!data || type != 2)
+        return QString();
+
+    //the count includes the terminating 0
+    const char *text = reinterpret_cast<const char*>(data);
+    return QString::fromLatin1(text, qstrnlen(text, count));
+}
+
+//the JPEG thumbnail stored in IFD1, empty if there is none
+QByteArray ExifParser::getThumbnail() const {
+    const quint32 offset = getUnsigned(IFD1, JPEG_INTERCHANGE_FORMAT);
+    const quint32 length = getUnsigned(IFD1, JPEG_INTERCHANGE_FORMAT_LENGTH);
+    const uchar *data = bytesAt(offset, length);
+    if(offset < 8 || length == 0 || !data)
+        return QByteArray();
+
+    //copied, the data is only mapped as long as the parser exists
+    return QByteArray(reinterpret_cast<const char*>(data), length);
+}
+
+//finds the largest JPEG stored in a TIFF based camera RAW file. Walks all
+//directories, including the SubIFDs that hold the RAW data and the larger
+//previews. Only JPEGs that Qt can decode are considered, not the lossless
+//ones the RAW data is compressed with. The returned data is only valid as
+//long as the parser exists.
+QByteArray ExifParser::getPreview(QSize *size) const {
+    quint32 bestOffset = 0;
+    quint32 bestLength = 0;
+    QSize bestSize;
+
+    QList<quint32> pending;
+    QSet<quint32> visited;
+    pending.append(directories[IFD0]);
+
+    //the limit protects against directories pointing at each other
+    while(!pending.isEmpty() && visited.size() < 64) {
+        const quint32 directory = pending.takeFirst();
+        if(visited.contains(directory) || !isValidDirectory(directory))
+            continue;
+
+        visited.insert(directory);
+
+        const uchar *subIfds = findEntry(directory, SUB_IFDS);
+        const quint32 subIfdCount = subIfds ? readUnsignedLong(subIfds + 4) : 0;
+        for(quint32 i = 0; i < subIfdCount && i < 16; ++i)
+            pending.append(entryUnsigned(subIfds, 0, i));
+
+        const quint32 next = directory + 2 + readUnsignedShort(bytesAt(directory, 2)) * 12;
+        const uchar *nextDirectory = bytesAt(next, 4);
+        if(nextDirectory)
+            pending.append(readUnsignedLong(nextDirectory));
+
+        //a JPEG referenced like the EXIF thumbnail (ARW, NEF, CR2 thumbnails)
+        QList<QPair<quint32, quint32> > candidates;
+        candidates.append(qMakePair(entryUnsigned(findEntry(directory, JPEG_INTERCHANGE_FORMAT), 0),
+                                    entryUnsigned(findEntry(directory, JPEG_INTERCHANGE_FORMAT_LENGTH), 0)));
+
+        //JPEG compressed image in a single strip (CR2 previews, DNG previews)
+        const quint32 compression = entryUnsigned(findEntry(directory, COMPRESSION), 0);
+        const uchar *stripOffsets = findEntry(directory, STRIP_OFFSETS);
+        if((compression == 6 || compression == 7) && stripOffsets && readUnsignedLong(stripOffsets + 4) == 1) {
+            candidates.append(qMakePair(entryUnsigned(stripOffsets, 0),
+                                        entryUnsigned(findEntry(directory, STRIP_BYTE_COUNTS), 0)));
+        }
+
+        for(const QPair<quint32, quint32> &candidate : candidates) {
+            const QSize candidateSize = jpegSize(candidate.first, candidate.second);
+            if(!candidateSize.isEmpty()
+                    && (qint64)candidateSize.width() * candidateSize.height() > (qint64)bestSize.width() * bestSize.height()) {
+                bestOffset = candidate.first;
+                bestLength = candidate.second;
+                bestSize = candidateSize;
+            }
+        }
     }
 
-    return true;
+    if(size)
+        *size = bestSize;
+
+    const uchar *data = bytesAt(bestOffset, bestLength);
+    if(!bestSize.isValid() || !data)
+        return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(data), bestLength);
+}
+
+//position of the value of a SHORT tag with a single value in the file, so it
+//can be changed in place. -1 if the tag is missing or has another type.
+qint64 ExifParser::getShortOffset(Directory directory, quint16 tag) const {
+    const quint32 entryOffset = findEntryOffset(directories[directory], tag);
+    const uchar *entry = findEntry(directory, tag);
+    if(!entry || readUnsignedShort(entry + 2) != 3 || readUnsignedLong(entry + 4) != 1)
+        return -1;
+
+    //the value is stored in the entry itself
+    return tiffOffset + entryOffset + 8;
 }
 
-QByteArray ExifParser::decodeFormat(QByteArray &bytes) {
-    if(format == INTEL) {
-        //intel format, switch high and low bytes
-        QByteArray result;
+ExifParser::FormatType ExifParser::getFormat() const {
+    return format;
+}
+
+//walks the JPEG segments until the APP1 segment with EXIF data
+bool ExifParser::findExifSegment(qint64 &offset, quint32 &length) {
+    uchar header[4];
+    qint64 pos = 2;
+    forever {
+        //marker (2 bytes) and length of the segment including the length (2 bytes)
+        if(!file.seek(pos) || file.read(reinterpret_cast<char*>(header), 4) != 4 || header[0] != 0xFF)
+            return false;
 
-        if(bytes.size() % 2 != 0 && bytes.size() != 1) {
-            std::cerr << "decodeFormat: Error" << std::endl;
-            return result;
+        //fill bytes before a marker
+        if(header[1] == 0xFF) {
+            pos++;
+            continue;
         }
 
-        if(bytes.size() < 2)
-            return bytes;
+        //start of scan or end of image, EXIF data has to come before
+        if(header[1] == 0xDA || header[1] == 0xD9)
+            return false;
 
-        result.resize(bytes.size());
+        const quint32 segmentLength = (header[2] << 8) | header[3];
+        if(segmentLength < 2)
+            return false;
 
-        int j = bytes.size() - 1;
-        for(int i = 0; i < bytes.size(); i++) {
-            result[i] = bytes.at(j);
-            j--;
+        //code "Exif" (6 bytes) followed by the TIFF header (8 bytes)
+        if(header[1] == 0xE1 && segmentLength >= 2 + 6 + 8) {
+            char code[6];
+            if(file.read(code, 6) != 6)
+                return false;
+
+            if(memcmp(code, "Exif\0\0", 6) == 0) {
+                offset = pos + 4 + 6;
+                length = segmentLength - 2 - 6;
+                return true;
+            }
         }
 
-        return result;
-    }
-    else {
-        //motorola format, bytes are in correct order
-        return bytes;
+        pos += 2 + segmentLength;
     }
 }
 
-QString ExifParser::readTag(unsigned short tagPos, QByteArray &buffer) {
-    QString result;
-    QByteArray tag = buffer.mid(tagPos, 12);
+//reads the TIFF header and finds the directories
+bool ExifParser::parseHeader() {
+    const uchar *header = bytesAt(0, 8);
+    if(!header)
+        return false;
+
+    //check if intel or motorola format is used (2 bytes in TIFF header)
+    if(header[0] == 'I' && header[1] == 'I')
+        format = INTEL;
+    else if(header[0] == 'M' && header[1] == 'M')
+        format = MOTOROLA;
+    else
+        return false;
+
+    if(readUnsignedShort(header + 2) != 42)
+        return false;
 
-    //one tag is 12 bytes long
-    //2 bytes: type of tag
-    unsigned short vendorType = 0x10F;
-    unsigned short cameraType = 0x110;
-    unsigned short orientationType = 0x112;
-    //... other types
+    const quint32 ifd0 = readUnsignedLong(header + 4);
+    if(!isValidDirectory(ifd0))
+        return false;
 
-    unsigned short tagType = readUnsignedShort(tag.mid(0, 2));
-    if(tagType == vendorType) {
-        result.append("Vendor: ");
-    }
-    else if(tagType == orientationType) {
-        result.append("Orientation: ");
+    directories[IFD0] = ifd0;
+
+    //the offset of the next directory follows the entries
+    const quint32 next = ifd0 + 2 + readUnsignedShort(bytesAt(ifd0, 2)) * 12;
+    const uchar *nextDirectory = bytesAt(next, 4);
+    if(nextDirectory) {
+        const quint32 ifd1 = readUnsignedLong(nextDirectory);
+        if(isValidDirectory(ifd1))
+            directories[IFD1] = ifd1;
     }
 
-    //4 bytes: length of data (as 32 bit number)
-    unsigned long dataLength = readUnsignedLong(tag.mid(4, 4));
+    const quint32 exifIfd = getUnsigned(IFD0, EXIF_IFD_POINTER);
+    if(isValidDirectory(exifIfd))
+        directories[EXIF_IFD] = exifIfd;
 
-    //4 bytes: data in the tag or offset to the data if more than 4 bytes
-    if(tagType == orientationType) {
-        orientation = readUnsignedShort(tag.mid(8, 2));
-        result.append(QString::number(orientation));
-    }
-    else if(tagType == vendorType) {
-        if(dataLength > 4) {
-            //read offset (from tiff header begin)
-            unsigned long offset = readUnsignedLong(tag.mid(8, 4));
-            result.append("Offset: " + QString::number(offset));
-
-            //use offset to read data
-            QString vendorString = readQString(buffer.mid(12 + offset, dataLength));
-            result.append(" VendorString: " + vendorString);
-        }
+    const quint32 gpsIfd = getUnsigned(IFD0, GPS_IFD_POINTER);
+    if(isValidDirectory(gpsIfd))
+        directories[GPS_IFD] = gpsIfd;
+
+    return true;
+}
+
+//returns size bytes at offset of the TIFF structure, 0 if they are outside of it.
+//Files that aren't mapped are read in parts of at least 4 KB, which stay
+//valid as long as the parser exists.
+const uchar* ExifParser::bytesAt(quint32 offset, quint64 size) const {
+    if((quint64)offset + size > tiffLength)
+        return 0;
+
+    if(tiff)
+        return tiff + offset;
+
+    QMultiMap<quint32, QByteArray>::const_iterator it = chunks.upperBound(offset);
+    if(it != chunks.constBegin()) {
+        --it;
+        if((quint64)it.key() + it.value().size() >= (quint64)offset + size)
+            return reinterpret_cast<const uchar*>(it.value().constData()) + (offset - it.key());
     }
 
-    return result;
+    //a directory never needs that much, only embedded previews
+    if(size > 64 * 1024 * 1024 || !file.seek(tiffOffset + offset))
+        return 0;
+
+    const qint64 readSize = qMin((qint64)qMax(size, (quint64)4096), (qint64)tiffLength - offset);
+    const QByteArray chunk = file.read(readSize);
+    if(chunk.size() != readSize)
+        return 0;
+
+    it = chunks.insert(offset, chunk);
+    return reinterpret_cast<const uchar*>(it.value().constData());
 }
 
-unsigned short ExifParser::readUnsignedShort(QByteArray bytes) {
-    if(bytes.size() > 2) {
-        std::cerr << "readUnsignedShort: Error: argument contains more than 2 bytes!" << std::endl;
+//true if the number of entries and all entries (12 bytes each) are inside the data
+bool ExifParser::isValidDirectory(quint32 offset) const {
+    //the header takes the first 8 bytes
+    if(offset < 8)
+        return false;
+
+    const uchar *count = bytesAt(offset, 2);
+    if(!count)
+        return false;
+
+    return (quint64)offset + 2 + readUnsignedShort(count) * 12 <= tiffLength;
+}
+
+//returns the 12 byte entry of the tag or 0
+const uchar* ExifParser::findEntry(Directory directory, quint16 tag) const {
+    return findEntry(directories[directory], tag);
+}
+
+//same for a directory at the given offset, which has to be valid
+const uchar* ExifParser::findEntry(quint32 offset, quint16 tag) const {
+    const quint32 entryOffset = findEntryOffset(offset, tag);
+    if(entryOffset == 0)
         return 0;
+
+    return bytesAt(entryOffset, 12);
+}
+
+//offset of the entry of the tag, 0 if the directory doesn't have it
+quint32 ExifParser::findEntryOffset(quint32 offset, quint16 tag) const {
+    if(offset == 0)
+        return 0;
+
+    const uchar *countData = bytesAt(offset, 2);
+    if(!countData)
+        return 0;
+
+    //the whole directory at once, so a file that isn't mapped is read only once
+    const int count = readUnsignedShort(countData);
+    const uchar *entry = bytesAt(offset + 2, count * 12);
+    if(!entry)
+        return 0;
+
+    for(int i = 0; i < count; ++i, entry += 12) {
+        if(readUnsignedShort(entry) == tag)
+            return offset + 2 + i * 12;
     }
 
-    //convert from intel format if neccessary
-    QByteArray decoded = decodeFormat(bytes);
-    //convert high byte and move 8 bits to the left, then add low byte
-    unsigned short result = ((unsigned short)decoded.at(0) << 8)
-            | decoded.at(1);
+    return 0;
+}
 
-    return result;
+//value of a BYTE, SHORT or LONG entry
+quint32 ExifParser::entryUnsigned(const uchar *entry, quint32 defaultValue, quint32 index) const {
+    quint32 count = 0;
+    quint16 type = 0;
+    const uchar *data = valueData(entry, count, type);
+    if(!data || index >= count)
+        return defaultValue;
+
+    switch(type) {
+    case 1:
+        return data[index];
+    case 3:
+        return readUnsignedShort(data + index * 2);
+    case 4:
+    case 13:
+        return readUnsignedLong(data + index * 4);
+    default:
+        return defaultValue;
+    }
 }
 
-QString ExifParser::readQString(QByteArray bytes) {
-    QString result;
+//size of the JPEG at the given offset, read from its frame header.
+//Invalid if it is not a baseline, extended or progressive JPEG.
+QSize ExifParser::jpegSize(quint32 offset, quint32 length) const {
+    const quint64 end = (quint64)offset + length;
+    if(offset == 0 || length < 4 || end > tiffLength)
+        return QSize();
+
+    //only the segment headers are read, not the whole JPEG
+    const uchar *start = bytesAt(offset, 2);
+    if(!start || start[0] != 0xFF || start[1] != 0xD8)
+        return QSize();
+
+    //markers and lengths are always big endian in JPEGs
+    quint64 pos = 2;
+    while(pos + 4 <= length) {
+        const uchar *data = bytesAt(offset + pos, 4);
+        if(!data || data[0] != 0xFF)
+            return QSize();
+
+        const uchar marker = data[1];
+        if(marker == 0xFF) {
+            pos++;
+            continue;
+        }
+
+        const quint32 segmentLength = (data[2] << 8) | data[3];
+
+        //start of frame, all markers from C0 to CF except DHT (C4), JPG (C8) and DAC (CC)
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            const uchar *frame = bytesAt(offset + pos, 9);
+            if(marker > 0xC2 || pos + 9 > length || !frame)
+                return QSize();
+
+            //precision (1 byte), height (2 bytes), width (2 bytes)
+            const int height = (frame[5] << 8) | frame[6];
+            const int width = (frame[7] << 8) | frame[8];
+            return QSize(width, height);
+        }
+
+        if(marker == 0xDA || marker == 0xD9 || segmentLength < 2)
+            return QSize();
 
-    char *data = bytes.data();
-    while (*data) {
-        result.append(*data);
-        ++data;
+        pos += 2 + segmentLength;
     }
 
-    return result;
+    return QSize();
 }
 
-unsigned long ExifParser::readUnsignedLong(QByteArray bytes) {
-    if(bytes.size() > 4) {
-        std::cerr << "readUnsignedLong: Error: argument contains more than 4 bytes!" << std::endl;
+//returns the values of the entry, stored in the entry itself if they fit
+//into 4 bytes, otherwise at an offset. 0 if they are outside of the data.
+const uchar* ExifParser::valueData(const uchar *entry, quint32 &count, quint16 &type) const {
+    if(!entry)
         return 0;
-    }
 
-    //convert from intel format if neccessary
-    QByteArray decoded = decodeFormat(bytes);
+    type = readUnsignedShort(entry + 2);
+    count = readUnsignedLong(entry + 4);
+
+    const quint64 size = (quint64)typeSize(type) * count;
+    if(size == 0)
+        return 0;
+
+    if(size <= 4)
+        return entry + 8;
+
+    return bytesAt(readUnsignedLong(entry + 8), size);
+}
 
-    unsigned long result = ((unsigned long)decoded.at(0) << 24)
-            | ((unsigned long)decoded.at(1) << 16)
-            | ((unsigned long)decoded.at(2) << 8)
-            | (unsigned long)decoded.at(3);
+unsigned short ExifParser::readUnsignedShort(const uchar *data) const {
+    if(format == INTEL)
+        return data[0] | (data[1] << 8);
 
-    return result;
+    //motorola format, bytes are in correct order
+    return (data[0] << 8) | data[1];
 }
 
+quint32 ExifParser::readUnsignedLong(const uchar *data) const {
+    if(format == INTEL)
+        return data[0] | ((quint32)data[1] << 8) | ((quint32)data[2] << 16) | ((quint32)data[3] << 24);
+
+    return ((quint32)data[0] << 24) | ((quint32)data[1] << 16) | ((quint32)data[2] << 8) | data[3];
+}
+
+//size of one value of the given type in bytes, 0 for unknown types
+int ExifParser::typeSize(quint16 type) {
+    switch(type) {
+    case 1: //BYTE
+    case 2: //ASCII
+    case 6: //SBYTE
+    case 7: //UNDEFINED
+        return 1;
+    case 3: //SHORT
+    case 8: //SSHORT
+        return 2;
+    case 4: //LONG
+    case 9: //SLONG
+    case 11: //FLOAT
+    case 13: //IFD
+        return 4;
+    case 5: //RATIONAL
+    case 10: //SRATIONAL
+    case 12: //DOUBLE
+        return 8;
+    default:
+        return 0;
+    }
+}
@@ -3,16 +3,25 @@
 
 #include <QUrl>
 #include <QByteArray>
-#include <vector>
+#include <QFile>
+#include <QMultiMap>
+#include <QString>
+#include <QSize>
 
 // http://www.waimea.de/downloads/exif/EXIF-Datenformat.pdf
 
+//reads the EXIF data of a JPEG file. Only the APP1 segment is read (memory
+//mapped if possible), tags are looked up and decoded when they are asked for.
+//Every offset in the file is checked, broken files just have no tags.
+//TIFF based files (TIFF, DNG and most camera RAW formats) are a TIFF
+//structure themselves, their directories are read the same way. If such
+//a file can't be mapped, only the parts that are needed are read from it.
 class ExifParser
 {
 public:
     ExifParser(QUrl imageUrl);
-    bool isValidExifData();
-    unsigned short getOrientation();
+    bool isValidExifData() const;
+    unsigned short getOrientation() const;
 
     //intel = little endian, motorola = big endian
     enum FormatType {
@@ -20,34 +29,78 @@ public:
         MOTOROLA
     };
 
+    //image file directories, IFD1 describes the embedded thumbnail
+    enum Directory {
+        IFD0,
+        EXIF_IFD,
+        GPS_IFD,
+        IFD1,
+        DIRECTORY_COUNT
+    };
+
+    enum Tag {
+        NEW_SUBFILE_TYPE = 0x00FE,
+        COMPRESSION = 0x0103,
+        MAKE = 0x010F,
+        MODEL = 0x0110,
+        STRIP_OFFSETS = 0x0111,
+        ORIENTATION = 0x0112,
+        STRIP_BYTE_COUNTS = 0x0117,
+        SUB_IFDS = 0x014A,
+        DATE_TIME = 0x0132,
+        JPEG_INTERCHANGE_FORMAT = 0x0201,
+        JPEG_INTERCHANGE_FORMAT_LENGTH = 0x0202,
+        EXPOSURE_TIME = 0x829A,
+        F_NUMBER = 0x829D,
+        EXIF_IFD_POINTER = 0x8769,
+        ISO_SPEED = 0x8827,
+        GPS_IFD_POINTER = 0x8825,
+        DATE_TIME_ORIGINAL = 0x9003,
+        FOCAL_LENGTH = 0x920A
+    };
+
+    bool hasTag(Directory directory, quint16 tag) const;
+    quint32 getCount(Directory directory, quint16 tag) const;
+    quint32 getUnsigned(Directory directory, quint16 tag, quint32 defaultValue = 0, quint32 index = 0) const;
+    double getRational(Directory directory, quint16 tag, quint32 index = 0) const;
+    QString getString(Directory directory, quint16 tag) const;
+    QByteArray getThumbnail() const;
+    QByteArray getPreview(QSize *size = 0) const;
+    qint64 getShortOffset(Directory directory, quint16 tag) const;
+    FormatType getFormat() const;
+
 private:
     QUrl imageUrl;
+    //read from while parsing if the TIFF structure isn't mapped
+    mutable QFile file;
     FormatType format;
     bool isValid;
-    unsigned short exifLength;
-    //positions of relevant data
-    int exifStartPos;
-    unsigned short exifLengthPos;
-    unsigned short exifCodePos;
-    unsigned short tiffHeaderPos;
-    unsigned short tagAmountPos;
-    std::vector<unsigned short> tagPositions;
-    //comparison codes
-    QByteArray markerJpegStart;
-    QByteArray markerExifStart;
-    QByteArray exifCode;
-    QByteArray intelFormatCode;
-    QByteArray motorolaFormatCode;
-    //data from tags
-    unsigned short orientation;
-
-    //private methods
-    bool compareBytes(QByteArray &source, QByteArray &comparison, int startIndex);
-    QByteArray decodeFormat(QByteArray &bytes);
-    QString readTag(unsigned short tagPos, QByteArray &buffer);
-    unsigned short readUnsignedShort(QByteArray bytes);
-    QString readQString(QByteArray bytes);
-    unsigned long readUnsignedLong(QByteArray bytes);
+    //the TIFF structure inside of the APP1 segment, all offsets are relative to it.
+    //0 if it is read in parts
+    const uchar *tiff;
+    quint32 tiffLength;
+    //position of the TIFF structure in the file
+    qint64 tiffOffset;
+    //the APP1 segment if the file can't be mapped
+    QByteArray buffer;
+    //parts of TIFF files that can't be mapped, by their offset
+    mutable QMultiMap<quint32, QByteArray> chunks;
+    //offsets of the directories, 0 if the file doesn't have them
+    quint32 directories[DIRECTORY_COUNT];
+
+    bool findExifSegment(qint64 &offset, quint32 &length);
+    bool parseHeader();
+    const uchar* bytesAt(quint32 offset, quint64 size) const;
+    bool isValidDirectory(quint32 offset) const;
+    const uchar* findEntry(Directory directory, quint16 tag) const;
+    const uchar* findEntry(quint32 directoryOffset, quint16 tag) const;
+    quint32 findEntryOffset(quint32 directoryOffset, quint16 tag) const;
+    quint32 entryUnsigned(const uchar *entry, quint32 defaultValue, quint32 index = 0) const;
+    QSize jpegSize(quint32 offset, quint32 length) const;
+    const uchar* valueData(const uchar *entry, quint32 &count, quint16 &type) const;
+    unsigned short readUnsignedShort(const uchar *data) const;
+    quint32 readUnsignedLong(const uchar *data) const;
+    static int typeSize(quint16 type);
 };
 
 #endif // EXIFPARSER_H
@@ -1,4 +1,6 @@
 #include "graphicsview.h"
+#include "tiledimageitem.h"
+#include "imageorientation.h"
 
 #include <QFile>
 #include <QMimeData>
@@ -30,31 +32,121 @@ GraphicsView::GraphicsView(QWidget *parent) :
 void GraphicsView::init() {
     wheelPosition = 40.0;
     scaleFactor = 1.0;
-    currentImage = new QGraphicsPixmapItem();
+    pixmapItem = new QGraphicsPixmapItem();
+    currentImage = pixmapItem;
     prevImageWidth = 0;
     prevImageHeight = 0;
+    displayScale = 1.0;
+    orientation = 1;
+    fullResolutionRequested = false;
+    regionMode = false;
+    regionItem = 0;
+    regionScale = 0.0;
     helpTextItem = 0;
 }
 
-void GraphicsView::changeImage(const QImage& image) {
+void GraphicsView::clearScene() {
     scene()->clear();
-    currentImage = scene()->addPixmap(QPixmap::fromImage(image));
+
+    //the region belongs to the previous image
+    regionMode = false;
+    regionItem = 0;
+    regionRect = QRect();
+}
+
+//fullSize is the size of the image at full resolution if image was
+//decoded at a reduced resolution. The orientation is applied when painting
+void GraphicsView::changeImage(const QImage& image, QSize fullSize, unsigned short orientation) {
+    clearScene();
+
+    //huge images would need a huge pixmap that is resampled as a whole on
+    //every paint, they are split into tiles with mip levels instead
+    if(TiledImageItem::isSuitable(image)) {
+        pixmapItem = 0;
+        currentImage = new TiledImageItem(image);
+        scene()->addItem(currentImage);
+    }
+    else {
+        pixmapItem = scene()->addPixmap(QPixmap::fromImage(image));
+        currentImage = pixmapItem;
+    }
+
+    if(!fullSize.isValid() || image.isNull())
+        fullSize = image.size();
+
+    this->fullSize = fullSize;
+    this->orientation = orientation;
+    updateImageTransform();
+
+    if(fullSize != image.size()) {
+        displayScale = (double)image.width() / fullSize.width();
+        fullResolutionRequested = false;
+    }
+    else {
+        displayScale = 1.0;
+    }
 
     //when switching between zoomed-in images of the same size, the
     //zoom should not reset. Also, if the image is smaller than the
     //graphicsscene it should not get "blown up" but stay at 1:1 size.
-    if(image.width() != prevImageWidth || image.height() != prevImageHeight) {
+    const QSize displayedSize = imageRect().size().toSize();
+    if(displayedSize.width() != prevImageWidth || displayedSize.height() != prevImageHeight) {
         autoFit();
     }
+    else {
+        choosePixmapTransform();
+        checkResolution();
+    }
     
-    prevImageWidth = image.width();
-    prevImageHeight = image.height();
+    prevImageWidth = displayedSize.width();
+    prevImageHeight = displayedSize.height();
+}
+
+//mirrors and rotates the displayed image by changing the transform of its
+//item, the pixmap or tiles are not created again
+void GraphicsView::setOrientation(unsigned short orientation) {
+    if(orientation == this->orientation)
+        return;
+
+    this->orientation = orientation;
+    updateImageTransform();
+    autoFit();
+
+    //the region is requested again for the new orientation
+    if(regionMode)
+        setRegionMode(true);
+
+    const QSize displayedSize = imageRect().size().toSize();
+    prevImageWidth = displayedSize.width();
+    prevImageHeight = displayedSize.height();
+}
+
+//reduced resolution images are stretched to their full size and the
+//orientation is applied on top, so the scene always uses the pixel
+//coordinates of the displayed full resolution image
+void GraphicsView::updateImageTransform() {
+    const QRectF rect = currentImage->boundingRect();
+
+    QTransform transform;
+    if(!rect.isEmpty() && rect.size() != QSizeF(fullSize))
+        transform = QTransform::fromScale(fullSize.width() / rect.width(), fullSize.height() / rect.height());
+
+    currentImage->setTransform(transform * orientationTransform());
+}
+
+//maps full resolution pixels of the image to scene coordinates
+QTransform GraphicsView::orientationTransform() const {
+    return ImageOrientation::transform(orientation, fullSize);
 }
 
 void GraphicsView::changeImage(QMovie *gif, const QImage& firstFrame) {
-    scene()->clear();
-    currentImage = scene()->addPixmap(QPixmap::fromImage(firstFrame));
+    clearScene();
+    pixmapItem = scene()->addPixmap(QPixmap::fromImage(firstFrame));
+    currentImage = pixmapItem;
     currentImage->hide();
+    displayScale = 1.0;
+    fullSize = firstFrame.size();
+    orientation = 1;
 
     QLabel *gif_anim = new QLabel();
     gif_anim->setMovie(gif);
@@ -67,9 +159,49 @@ void GraphicsView::changeImage(QMovie *gif, const QImage& firstFrame) {
     prevImageHeight = 0;
 }
 
+//bounding rect of the image in scene coordinates (full resolution pixels)
+QRectF GraphicsView::imageRect() const {
+    return currentImage->sceneBoundingRect();
+}
+
+//enables decoding the visible region when zooming in, instead of the whole image
+void GraphicsView::setRegionMode(bool enabled) {
+    regionMode = enabled;
+    regionRect = QRect();
+
+    if(regionItem) {
+        scene()->removeItem(regionItem);
+        delete regionItem;
+        regionItem = 0;
+    }
+
+    checkRegion();
+}
+
+//displays a part of the image at a higher resolution than the reduced one.
+//rect is in full resolution pixels before the orientation, region may be downscaled
+void GraphicsView::showRegion(const QImage &region, QRect rect) {
+    if(!regionMode || region.isNull() || rect.isEmpty())
+        return;
+
+    if(regionItem) {
+        scene()->removeItem(regionItem);
+        delete regionItem;
+    }
+
+    regionItem = scene()->addPixmap(QPixmap::fromImage(region));
+    regionItem->setTransform(QTransform::fromScale((double)rect.width() / region.width(),
+                                                   (double)rect.height() / region.height())
+                             * QTransform::fromTranslate(rect.x(), rect.y())
+                             * orientationTransform());
+    regionItem->setZValue(1);
+
+    choosePixmapTransform();
+}
+
 void GraphicsView::autoFit() {
-    int width = currentImage->pixmap().width();
-    int height = currentImage->pixmap().height();
+    double width = imageRect().width();
+    double height = imageRect().height();
     
     if(width < this->width() && height < this->height()) {
         resetImageScale();
@@ -109,6 +241,18 @@ void GraphicsView::keyPressEvent(QKeyEvent *event) {
     case Qt::Key_Right:
         emit keyRightPressed();
         break;
+    case Qt::Key_Home:
+        emit keyHomePressed();
+        break;
+    case Qt::Key_End:
+        emit keyEndPressed();
+        break;
+    case Qt::Key_G:
+        //test if control is pressed as well
+        if(QApplication::keyboardModifiers() & Qt::ControlModifier) {
+            emit controlGPressed();
+        }
+        break;
     case Qt::Key_S:
         //test if control is pressed as well
         if(QApplication::keyboardModifiers() & Qt::ControlModifier) {
@@ -124,6 +268,14 @@ void GraphicsView::keyPressEvent(QKeyEvent *event) {
     case Qt::Key_R:
         emit rotatePressed();
         break;
+    case Qt::Key_T:
+        //control + T shows the thumbnails instead of the image
+        if(QApplication::keyboardModifiers() & Qt::ControlModifier) {
+            emit gridPressed();
+        } else {
+            emit filmstripPressed();
+        }
+        break;
     case Qt::Key_F:
         fitImageInView();
         break;
@@ -190,13 +342,24 @@ void GraphicsView::wheelEvent(QWheelEvent *event) {
     event->accept();
 }
 
+void GraphicsView::resizeEvent(QResizeEvent *event) {
+    QGraphicsView::resizeEvent(event);
+    checkRegion();
+}
+
+//called when panning, the visible region might have to be decoded
+void GraphicsView::scrollContentsBy(int dx, int dy) {
+    QGraphicsView::scrollContentsBy(dx, dy);
+    checkRegion();
+}
+
 void GraphicsView::mouseReleaseEvent(QMouseEvent *event) {
     if(event->button() == Qt::RightButton) {
         //rightclick -> reset image scale to 1:1
         resetImageScale();
         
-        double centerX = (double)(currentImage->pixmap().width() / width()) * event->pos().x();
-        double centerY = (double)(currentImage->pixmap().height() / height()) * event->pos().y();
+        double centerX = (double)((int)imageRect().width() / width()) * event->pos().x();
+        double centerY = (double)((int)imageRect().height() / height()) * event->pos().y();
         centerOn(centerX, centerY);
     }
     else if(event->button() == Qt::MiddleButton) {
@@ -207,10 +370,24 @@ void GraphicsView::mouseReleaseEvent(QMouseEvent *event) {
 
 //turn off AA when zooming in beyond 100%
 void GraphicsView::choosePixmapTransform() {
-    if(scaleFactor < 2.0)
-        currentImage->setTransformationMode(Qt::SmoothTransformation);
+    if(regionItem) {
+        //zoom relative to the pixels of the region, m12 is used if it is rotated
+        const QTransform transform = regionItem->transform();
+        if(scaleFactor * hypot(transform.m11(), transform.m12()) < 2.0)
+            regionItem->setTransformationMode(Qt::SmoothTransformation);
+        else
+            regionItem->setTransformationMode(Qt::FastTransformation);
+    }
+
+    //the tiled image item chooses by itself
+    if(!pixmapItem)
+        return;
+
+    //zoom relative to the pixels of the displayed pixmap
+    if(scaleFactor / displayScale < 2.0)
+        pixmapItem->setTransformationMode(Qt::SmoothTransformation);
     else
-        currentImage->setTransformationMode(Qt::FastTransformation);
+        pixmapItem->setTransformationMode(Qt::FastTransformation);
 }
 
 void GraphicsView::zoom(int wheelAngle) {
@@ -241,11 +418,53 @@ void GraphicsView::setScale() {
     
     emit scaleChanged(scaleFactor);
     choosePixmapTransform();
+    checkResolution();
+}
+
+//asks for the full resolution image once the reduced one would be magnified
+void GraphicsView::checkResolution() {
+    if(displayScale < 1.0 && !fullResolutionRequested && scaleFactor > displayScale * 1.01) {
+        fullResolutionRequested = true;
+        emit fullResolutionNeeded();
+    }
+
+    checkRegion();
+}
+
+//asks for the visible part of the image at the resolution of the current
+//zoom (at most 1:1) if the displayed region doesn't cover it
+void GraphicsView::checkRegion() {
+    if(!regionMode || scaleFactor <= displayScale * 1.01)
+        return;
+
+    const QRect bounds = imageRect().toAlignedRect();
+    const QRect visible = mapToScene(viewport()->rect()).boundingRect().toAlignedRect() & bounds;
+    if(visible.isEmpty())
+        return;
+
+    //halve the resolution as long as it is still enough for the zoom,
+    //so zooming in a little doesn't decode the region again
+    double scale = 1.0;
+    while(scale / 2.0 >= scaleFactor)
+        scale /= 2.0;
+
+    if(regionRect.contains(visible) && regionScale >= scale)
+        return;
+
+    //add a margin of a quarter of the visible size on every side,
+    //so panning doesn't need a new region right away
+    const int marginX = visible.width() / 4;
+    const int marginY = visible.height() / 4;
+    regionRect = visible.adjusted(-marginX, -marginY, marginX, marginY) & bounds;
+    regionScale = scale;
+
+    //the decoder doesn't know about the orientation of the view
+    emit regionNeeded(orientationTransform().inverted().mapRect(QRectF(regionRect)).toAlignedRect(), regionScale);
 }
 
 void GraphicsView::resetImageScale() {
     //adapt scene's bounding rect to image
-    scene()->setSceneRect(QRectF(0, 0, currentImage->pixmap().width(), currentImage->pixmap().height()));
+    scene()->setSceneRect(QRectF(0, 0, imageRect().width(), imageRect().height()));
     //fit scene into graphicsview
     fitInView(scene()->sceneRect(), Qt::KeepAspectRatio);
     
@@ -256,6 +475,8 @@ void GraphicsView::resetImageScale() {
     wheelPosition = 40.0; //the same as calcWheelPosition(1.0);
     
     emit scaleChanged(scaleFactor);
+    choosePixmapTransform();
+    checkResolution();
 }
 
 void GraphicsView::fitImageInView() {
@@ -264,7 +485,7 @@ void GraphicsView::fitImageInView() {
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     
     //adapt scene's bounding rect to image
-    scene()->setSceneRect(QRectF(0, 0, currentImage->pixmap().width(), currentImage->pixmap().height()));
+    scene()->setSceneRect(QRectF(0, 0, imageRect().width(), imageRect().height()));
 
     //fit scene into graphicsview
     //deprecated because of hardcoded 2 pixel border
@@ -291,6 +512,7 @@ void GraphicsView::fitImageInView() {
     
     emit scaleChanged(scaleFactor);
     choosePixmapTransform();
+    checkResolution();
 }
 
 double GraphicsView::calcScaleFactor(double wheelPos) const {
@@ -321,7 +543,7 @@ double GraphicsView::getScaleFactor() const {
 //display readme text in graphicsview
 void GraphicsView::showHelp() {
     if(!helpTextItem) {
-        scene()->clear();
+        clearScene();
         
         //load readme
         QString readmeText("Start by dropping images here");
@@ -339,7 +561,7 @@ void GraphicsView::showHelp() {
 }
 
 void GraphicsView::showText(QString text, QColor color) {
-    scene()->clear();
+    clearScene();
     
     QGraphicsSimpleTextItem *textItem = scene()->addSimpleText(text);
     textItem->setBrush(color);
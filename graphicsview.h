@@ -19,25 +19,50 @@ public:
     void mouseDoubleClickEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent* event);
     void mouseReleaseEvent(QMouseEvent* event);
-    void changeImage(const QImage &image);
+    void resizeEvent(QResizeEvent* event);
+    void scrollContentsBy(int dx, int dy);
+    void changeImage(const QImage &image, QSize fullSize = QSize(), unsigned short orientation = 1);
     void changeImage(QMovie *gif, const QImage& firstFrame);
+    void setOrientation(unsigned short orientation);
+    void setRegionMode(bool enabled);
+    void showRegion(const QImage &region, QRect rect);
     double getScaleFactor() const;
     void autoFit();
     void showHelp();
     void showText(QString text, QColor color = QColor(255, 255, 255));
     
 private:
-    QGraphicsPixmapItem *currentImage;
+    QGraphicsItem *currentImage;
+    //0 if the image is displayed by a TiledImageItem
+    QGraphicsPixmapItem *pixmapItem;
     int prevImageWidth;
     int prevImageHeight;
     double wheelPosition;
     double scaleFactor;
+    //size of the displayed pixmap relative to the full resolution image
+    double displayScale;
+    QSize fullSize;
+    //EXIF orientation the image is displayed with, without changing its pixels
+    unsigned short orientation;
+    bool fullResolutionRequested;
+    //in region mode only the visible part of the image is decoded at
+    //full resolution and displayed on top of the reduced one
+    bool regionMode;
+    QGraphicsPixmapItem *regionItem;
+    QRect regionRect;
+    double regionScale;
     QGraphicsSimpleTextItem *helpTextItem;
     
     void init();
+    void clearScene();
     void zoom(int wheelAngle);
     void setScale();
     void choosePixmapTransform();
+    void updateImageTransform();
+    QTransform orientationTransform() const;
+    void checkResolution();
+    void checkRegion();
+    QRectF imageRect() const;
     double calcScaleFactor(double wheelPos) const;
     double calcWheelPosition(double scaleFac) const;
     
@@ -52,14 +77,21 @@ signals:
     void folderDropped(QUrl url);
     void keyLeftPressed();
     void keyRightPressed();
+    void keyHomePressed();
+    void keyEndPressed();
+    void controlGPressed();
     void controlSPressed();
     void controlCPressed();
     void scaleChanged(double newScale);
+    void fullResolutionNeeded();
+    void regionNeeded(QRect rect, double scale);
     void doubleClicked();
     void deletePressed();
     void rotatePressed();
     void markPressed();
     void copyMarkedPressed();
+    void filmstripPressed();
+    void gridPressed();
     
 private slots:
     void printPreview(QPrinter *printer);
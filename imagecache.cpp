@@ -0,0 +1,132 @@
+#include "imagecache.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QSettings>
+
+#include <climits>
+
+ImageCache::ImageCache() {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+
+    QSettings qsettings( "simon", "imagepreview" );
+    setBudget(qsettings.value( "cache/budgetMB", 1024 ).toLongLong() * 1024 * 1024);
+}
+
+void ImageCache::setBudget(qint64 bytes) {
+    QMutexLocker locker(&mutex);
+    const int before = cache.count();
+    cache.setMaxCost((int)qMin<qint64>(bytes / 1024, INT_MAX));
+    evictions += before - cache.count();
+}
+
+qint64 ImageCache::getBudget() const {
+    QMutexLocker locker(&mutex);
+    return (qint64)cache.maxCost() * 1024;
+}
+
+//returns the cached image or decodes and caches it.
+//A set cancelFlag stops the decoder, see ImageDecoder::setCancelFlag()
+ImageDecoder ImageCache::load(QString path, QSize maxSize, QSharedPointer<QAtomicInt> cancelFlag) {
+    ImageDecoder decoder;
+    if(find(path, decoder, maxSize))
+        return decoder;
+
+    decoder = ImageDecoder(path, maxSize);
+    decoder.setCancelFlag(cancelFlag);
+    if(decoder.decode() && !decoder.isAnimated())
+        insert(decoder);
+
+    return decoder;
+}
+
+//returns true and sets decoder if the file is cached in its current version.
+//A full resolution image is also accepted if a reduced one was asked for.
+bool ImageCache::find(QString path, ImageDecoder &decoder, QSize maxSize) {
+    const QString key = makeKey(path, maxSize);
+    const QString fullKey = makeKey(path, QSize());
+
+    QMutexLocker locker(&mutex);
+    //object() also marks the entry as the most recently used one
+    ImageDecoder *cached = cache.object(key);
+    if(!cached && maxSize.isValid())
+        cached = cache.object(fullKey);
+
+    if(!cached) {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    decoder = *cached;
+    return true;
+}
+
+bool ImageCache::contains(QString path, QSize maxSize) const {
+    const QString key = makeKey(path, maxSize);
+    const QString fullKey = makeKey(path, QSize());
+
+    QMutexLocker locker(&mutex);
+    return cache.contains(key) || (maxSize.isValid() && cache.contains(fullKey));
+}
+
+void ImageCache::insert(const ImageDecoder &decoder) {
+    if(decoder.getImage().isNull())
+        return;
+
+    //images that were small enough anyway are stored as full resolution ones
+    const QString key = makeKey(decoder.getPath(), decoder.isFullResolution() ? QSize() : decoder.getMaxSize());
+    const int cost = (int)qMax<qint64>(1, decoder.getImage().sizeInBytes() / 1024);
+
+    QMutexLocker locker(&mutex);
+    const bool replacing = cache.contains(key);
+    const int expectedCount = cache.count() + (replacing ? 0 : 1);
+
+    //QImage is implicitly shared, this does not copy the pixels
+    if(!cache.insert(key, new ImageDecoder(decoder), cost))
+        return; //larger than the whole budget
+
+    evictions += expectedCount - cache.count();
+}
+
+void ImageCache::clear() {
+    QMutexLocker locker(&mutex);
+    cache.clear();
+}
+
+qint64 ImageCache::getUsedBytes() const {
+    QMutexLocker locker(&mutex);
+    return (qint64)cache.totalCost() * 1024;
+}
+
+qint64 ImageCache::getHits() const {
+    QMutexLocker locker(&mutex);
+    return hits;
+}
+
+qint64 ImageCache::getMisses() const {
+    QMutexLocker locker(&mutex);
+    return misses;
+}
+
+qint64 ImageCache::getEvictions() const {
+    QMutexLocker locker(&mutex);
+    return evictions;
+}
+
+QString ImageCache::makeKey(QString path, QSize maxSize) {
+    QFileInfo fileInfo(path);
+    QString key = fileInfo.absoluteFilePath() + "|"
+            + QString::number(fileInfo.lastModified().toMSecsSinceEpoch()) + "|"
+            + QString::number(fileInfo.size()) + "|";
+
+    if(maxSize.isValid())
+        key += QString::number(maxSize.width()) + "x" + QString::number(maxSize.height());
+    else
+        key += "full";
+
+    return key;
+}
@@ -0,0 +1,41 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QSize>
+#include "imagedecoder.h"
+
+//thread safe LRU cache of decoded images with a memory budget.
+//Entries are keyed by path, modification time, file size and the size
+//they were decoded for, so a modified file never returns the stale image.
+class ImageCache
+{
+public:
+    ImageCache();
+    void setBudget(qint64 bytes);
+    qint64 getBudget() const;
+    ImageDecoder load(QString path, QSize maxSize = QSize(), QSharedPointer<QAtomicInt> cancelFlag = QSharedPointer<QAtomicInt>());
+    bool find(QString path, ImageDecoder &decoder, QSize maxSize = QSize());
+    bool contains(QString path, QSize maxSize = QSize()) const;
+    void insert(const ImageDecoder &decoder);
+    void clear();
+    qint64 getUsedBytes() const;
+    qint64 getHits() const;
+    qint64 getMisses() const;
+    qint64 getEvictions() const;
+
+private:
+    mutable QMutex mutex;
+    //costs are counted in kilobytes, QCache only supports int costs
+    QCache<QString, ImageDecoder> cache;
+    qint64 hits;
+    qint64 misses;
+    qint64 evictions;
+
+    static QString makeKey(QString path, QSize maxSize);
+};
+
+#endif // IMAGECACHE_H
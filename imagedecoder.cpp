@@ -0,0 +1,415 @@
+#include "imagedecoder.h"
+#include "exifparser.h"
+#include "tiffreader.h"
+#include "imageorientation.h"
+#include "psdreader.h"
+#include "paralleldecoder.h"
+#include "thumbnailcache.h"
+#include "resampler.h"
+
+#include <QImageReader>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QTransform>
+#include <QUrl>
+#include <QSettings>
+
+ImageDecoder::ImageDecoder() {
+    animated = false;
+    cancelled = false;
+}
+
+ImageDecoder::ImageDecoder(QString path, QSize maxSize) {
+    this->path = path;
+    this->maxSize = maxSize;
+    animated = false;
+    cancelled = false;
+}
+
+bool ImageDecoder::decode() {
+    if(checkCancelled())
+        return false;
+
+    //the merged image of PSD files is read directly, other color modes
+    //and compressions are left to Qt's plugin
+    if(PsdReader::isPsdFile(path)) {
+        PsdReader psd(path);
+        if(psd.isValid()) {
+            fullSize = psd.getSize();
+            QSize scaledSize = fullSize;
+            if(maxSize.isValid() && (fullSize.width() > maxSize.width() || fullSize.height() > maxSize.height()))
+                scaledSize = fullSize.scaled(maxSize, Qt::KeepAspectRatio);
+
+            image = psd.read(QRect(), scaledSize);
+            if(!image.isNull())
+                return true;
+        }
+    }
+
+    ExifParser exifParser(QUrl::fromLocalFile(path));
+
+    //camera RAW files are displayed by their embedded JPEG preview,
+    //which is decoded like any other JPEG straight from the mapped file
+    QByteArray preview;
+    QBuffer previewBuffer(&preview);
+    QImageReader reader;
+    if(isRawFile(path)) {
+        preview = exifParser.getPreview();
+        if(preview.isEmpty()) {
+            errorString = "No embedded preview found";
+            return false;
+        }
+
+        previewBuffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&previewBuffer);
+    }
+    else {
+        reader.setFileName(path);
+    }
+
+    //huge images are displayed tiled, so they may be larger than Qt's default limit
+    QSettings qsettings( "simon", "imagepreview" );
+    const int allocationLimit = qsettings.value( "decode/allocationLimitMB", 8192 ).toInt();
+    reader.setAllocationLimit(allocationLimit);
+
+    //Qt's TIFF plugin applies the orientation tag by itself, it is applied
+    //once below, after the image has been resized
+    reader.setAutoTransform(false);
+
+    animated = reader.supportsAnimation();
+
+    //animated images are displayed by a QMovie, which ignores EXIF data anyway.
+    //The orientation of RAW files applies to their preview
+    const unsigned short orientation = animated ? 1 : exifParser.getOrientation();
+    const bool transposed = ImageOrientation::isTransposed(orientation);
+
+    QSize size = reader.size();
+    fullSize = transposed ? size.transposed() : size;
+
+    //the reduction is done by the resampler. JPEGs are reduced by a power of two
+    //while decoding first, the plugin's IDCT scaling is fast and exact
+    QSize scaledSize;
+    bool scaled = false;
+    if(maxSize.isValid() && !animated && fullSize.isValid()
+            && (fullSize.width() > maxSize.width() || fullSize.height() > maxSize.height())) {
+        scaledSize = fullSize.scaled(maxSize, Qt::KeepAspectRatio);
+        if(transposed)
+            scaledSize.transpose();
+
+        if(reader.format() == "jpeg") {
+            const QSize reduced = getJpegReduction(size, scaledSize);
+            if(reduced != size) {
+                reader.setScaledSize(reduced);
+                scaled = true;
+            }
+        }
+    }
+
+    //large JPEGs with restart markers and striped or tiled TIFFs are decoded
+    //on all cores at full resolution, the rest by the reader
+    const qint64 parallelThreshold = qsettings.value( "decode/parallelThresholdMP", 16 ).toLongLong() * 1000000;
+    if(!scaled && !animated && !isRawFile(path) && size.isValid()
+            && (qint64)size.width() * size.height() >= parallelThreshold
+            && (qint64)size.width() * size.height() * 4 <= (qint64)allocationLimit * 1024 * 1024) {
+        ParallelDecoder parallelDecoder(path);
+        parallelDecoder.setCancelFlag(cancelFlag);
+        image = parallelDecoder.read();
+    }
+
+    if(checkCancelled())
+        return false;
+
+    if(image.isNull())
+        image = reader.read();
+
+    if(image.isNull()) {
+        errorString = reader.errorString();
+        return false;
+    }
+
+    //before the orientation is applied, there are fewer pixels to move afterwards
+    if(scaledSize.isValid() && image.size() != scaledSize) {
+        const QImage resized = Resampler::resize(image, scaledSize, Resampler::getFilter(qsettings.value( "decode/resampleFilter", "lanczos3" ).toString()));
+        if(!resized.isNull())
+            image = resized;
+    }
+
+    if(!animated)
+        image = ImageOrientation::apply(image, orientation);
+
+    //not every format reports its size before decoding
+    if(!fullSize.isValid())
+        fullSize = image.size();
+
+    return true;
+}
+
+//decodes the part rect (in full resolution pixels, after EXIF orientation)
+//of the image, downscaled by scale. The region is grown to the blocks TIFF
+//files are stored in, getRegion() returns the part that was decoded.
+bool ImageDecoder::decodeRegion(QRect rect, double scale) {
+    //PSD files have no EXIF orientation, rows outside of the region are skipped
+    if(PsdReader::isPsdFile(path)) {
+        PsdReader psd(path);
+        if(psd.isValid()) {
+            fullSize = psd.getSize();
+            region = rect & QRect(QPoint(0, 0), fullSize);
+
+            const QSize scaledSize = (QSizeF(region.size()) * qBound(0.0, scale, 1.0)).toSize().expandedTo(QSize(1, 1));
+            image = psd.read(region, scaledSize);
+            if(image.isNull())
+                errorString = psd.getErrorString();
+
+            return !image.isNull();
+        }
+    }
+
+    QImageReader reader(path);
+    QSettings qsettings( "simon", "imagepreview" );
+    reader.setAllocationLimit(qsettings.value( "decode/allocationLimitMB", 8192 ).toInt());
+    reader.setAutoTransform(false);
+
+    const QSize size = reader.size();
+    if(!size.isValid()) {
+        errorString = reader.errorString();
+        return false;
+    }
+
+    //the reader clips before rotating, so the region is mapped back to file pixels
+    const unsigned short orientation = readOrientation();
+    const QTransform transform = ImageOrientation::transform(orientation, size);
+    fullSize = transform.mapRect(QRectF(QPoint(0, 0), size)).size().toSize();
+
+    const QRect bounds(QPoint(0, 0), size);
+    QRect clipRect = transform.inverted().mapRect(QRectF(rect)).toAlignedRect() & bounds;
+
+    //TIFF strips and tiles are decoded as a whole anyway
+    TiffReader tiff(path);
+    if(tiff.isValid())
+        clipRect = alignToBlocks(clipRect, tiff.getBlockSize()) & bounds;
+
+    if(clipRect.isEmpty()) {
+        errorString = "Region outside of the image";
+        return false;
+    }
+
+    const QSize scaledSize = (QSizeF(clipRect.size()) * qBound(0.0, scale, 1.0)).toSize().expandedTo(QSize(1, 1));
+
+    //Qt's TIFF plugin would decode the whole image and crop it afterwards.
+    //Uncompressed rows are read directly, compressed strips and tiles that
+    //intersect the region are decoded on their own.
+    if(tiff.canReadRegion()) {
+        image = tiff.readRegion(clipRect);
+    }
+    else if(tiff.isValid()) {
+        ParallelDecoder parallelDecoder(path);
+        image = parallelDecoder.readRegion(clipRect);
+    }
+
+    if(!image.isNull() && scaledSize != image.size())
+        image = image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    if(image.isNull()) {
+        //JPEGs skip the rows outside of the clip rect while decoding
+        reader.setClippingRect(clipRect);
+        if(scaledSize != clipRect.size())
+            reader.setScaledSize(scaledSize);
+
+        image = reader.read();
+    }
+
+    if(image.isNull()) {
+        errorString = reader.errorString();
+        return false;
+    }
+
+    image = ImageOrientation::apply(image, orientation);
+    region = transform.mapRect(QRectF(clipRect)).toAlignedRect();
+
+    return true;
+}
+
+//decodes the small JPEG embedded in the EXIF data instead of the image,
+//which only takes a few milliseconds. fullSize is the size of the image.
+bool ImageDecoder::decodeThumbnail() {
+    //Photoshop stores a thumbnail in the image resources
+    if(PsdReader::isPsdFile(path)) {
+        PsdReader psd(path);
+        image = psd.readThumbnail();
+        if(image.isNull())
+            return decodeCachedThumbnail();
+
+        fullSize = psd.getSize();
+        return true;
+    }
+
+    ExifParser exifParser(QUrl::fromLocalFile(path));
+    const QByteArray thumbnail = exifParser.getThumbnail();
+    if(thumbnail.isEmpty())
+        return decodeCachedThumbnail();
+
+    //RAW files are displayed by their preview, which defines the size
+    QSize size;
+    if(isRawFile(path)) {
+        exifParser.getPreview(&size);
+    }
+    else {
+        QImageReader reader(path);
+        reader.setAutoTransform(false);
+        size = reader.size();
+    }
+
+    image = QImage::fromData(thumbnail, "JPG");
+    if(image.isNull() || !size.isValid()) {
+        errorString = "Invalid embedded thumbnail";
+        image = QImage();
+        return false;
+    }
+
+    //cameras pad thumbnails with black bars to 4:3, crop them to the aspect ratio of the image
+    const QSize cropped = size.scaled(image.size(), Qt::KeepAspectRatio);
+    if(cropped != image.size() && !cropped.isEmpty()) {
+        image = image.copy(QRect(QPoint((image.width() - cropped.width()) / 2,
+                                        (image.height() - cropped.height()) / 2), cropped));
+    }
+
+    const unsigned short orientation = exifParser.getOrientation();
+    image = ImageOrientation::apply(image, orientation);
+    fullSize = ImageOrientation::isTransposed(orientation) ? size.transposed() : size;
+
+    return true;
+}
+
+//the decoder stops as soon as it finds the flag set, decode() then fails
+void ImageDecoder::setCancelFlag(QSharedPointer<QAtomicInt> flag) {
+    cancelFlag = flag;
+}
+
+bool ImageDecoder::isCancelled() const {
+    return cancelled;
+}
+
+const QImage& ImageDecoder::getImage() const {
+    return image;
+}
+
+QString ImageDecoder::getPath() const {
+    return path;
+}
+
+QString ImageDecoder::getErrorString() const {
+    return errorString;
+}
+
+QSize ImageDecoder::getMaxSize() const {
+    return maxSize;
+}
+
+QSize ImageDecoder::getFullSize() const {
+    return fullSize;
+}
+
+QRect ImageDecoder::getRegion() const {
+    return region;
+}
+
+bool ImageDecoder::isFullResolution() const {
+    return image.size() == fullSize;
+}
+
+bool ImageDecoder::isAnimated() const {
+    return animated;
+}
+
+//suffixes of the camera RAW formats that are displayed by their embedded preview
+QStringList ImageDecoder::getRawSuffixes() {
+    QStringList suffixes;
+    suffixes << "cr2" << "nef" << "nrw" << "arw" << "dng";
+    return suffixes;
+}
+
+bool ImageDecoder::isRawFile(QString path) {
+    return getRawSuffixes().contains(QFileInfo(path).suffix().toLower());
+}
+
+//the largest size the JPEG plugin decodes to without scaling on its own that
+//is still at least scaledSize. libjpeg reduces by 2, 4 or 8 and rounds up,
+//the plugin picks the largest factor that fits into the requested size
+QSize ImageDecoder::getJpegReduction(QSize size, QSize scaledSize) {
+    QSize reduced = size;
+    for(int factor = 2; factor <= 8; factor *= 2) {
+        const QSize candidate((size.width() + factor - 1) / factor, (size.height() + factor - 1) / factor);
+        if(candidate.width() < scaledSize.width() || candidate.height() < scaledSize.height())
+            break;
+
+        if(size.width() / candidate.width() >= factor && size.height() / candidate.height() >= factor)
+            reduced = candidate;
+    }
+
+    return reduced;
+}
+
+bool ImageDecoder::checkCancelled() {
+    cancelled = cancelFlag && cancelFlag->loadRelaxed();
+    if(cancelled) {
+        image = QImage();
+        errorString = "Cancelled";
+    }
+
+    return cancelled;
+}
+
+//the thumbnail a file manager (or the thumbnail view) stored in the shared
+//thumbnail cache. It was made from the decoded image, so it is already oriented.
+bool ImageDecoder::decodeCachedThumbnail() {
+    image = ThumbnailCache::load(path, ThumbnailCache::LARGE);
+    if(image.isNull())
+        image = ThumbnailCache::load(path, ThumbnailCache::NORMAL);
+
+    if(image.isNull()) {
+        errorString = "No embedded thumbnail";
+        return false;
+    }
+
+    if(PsdReader::isPsdFile(path)) {
+        fullSize = PsdReader(path).getSize();
+    }
+    else {
+        QSize size;
+        if(isRawFile(path))
+            ExifParser(QUrl::fromLocalFile(path)).getPreview(&size);
+        else
+            size = QImageReader(path).size();
+
+        fullSize = ImageOrientation::isTransposed(readOrientation()) ? size.transposed() : size;
+    }
+
+    if(!fullSize.isValid() || fullSize.isEmpty()) {
+        errorString = "Invalid cached thumbnail";
+        image = QImage();
+        return false;
+    }
+
+    return true;
+}
+
+unsigned short ImageDecoder::readOrientation() const {
+    ExifParser exifParser(QUrl::fromLocalFile(path));
+    if(exifParser.isValidExifData())
+        return exifParser.getOrientation();
+
+    return 1;
+}
+
+//grows rect to the grid of blocks with the given size
+QRect ImageDecoder::alignToBlocks(QRect rect, QSize blockSize) {
+    if(!blockSize.isValid() || blockSize.isEmpty())
+        return rect;
+
+    const int left = rect.left() / blockSize.width() * blockSize.width();
+    const int top = rect.top() / blockSize.height() * blockSize.height();
+    const int right = (rect.right() / blockSize.width() + 1) * blockSize.width();
+    const int bottom = (rect.bottom() / blockSize.height() + 1) * blockSize.height();
+
+    return QRect(left, top, right - left, bottom - top);
+}
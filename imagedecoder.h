@@ -0,0 +1,64 @@
+#ifndef IMAGEDECODER_H
+#define IMAGEDECODER_H
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QSharedPointer>
+#include <QString>
+#include <QSize>
+#include <QRect>
+#include <QStringList>
+
+//decodes an image file and applies its EXIF orientation.
+//Does not touch any widgets, so it can be used on worker threads.
+//If a maximum size is given, large images are decoded at a reduced
+//resolution that fits into it (JPEGs are scaled in the DCT domain).
+//decodeRegion() decodes only a part of the image, for zooming into
+//images that are too large to be kept at full resolution.
+//Camera RAW files are not demosaiced, their largest embedded JPEG
+//preview is decoded instead.
+//A decoder that is not needed anymore can be cancelled with the flag
+//given to setCancelFlag(), it stops at the next step it checks it.
+class ImageDecoder
+{
+public:
+    ImageDecoder();
+    ImageDecoder(QString path, QSize maxSize = QSize());
+    bool decode();
+    bool decodeRegion(QRect rect, double scale = 1.0);
+    bool decodeThumbnail();
+    void setCancelFlag(QSharedPointer<QAtomicInt> flag);
+    bool isCancelled() const;
+    const QImage& getImage() const;
+    QString getPath() const;
+    QString getErrorString() const;
+    QSize getMaxSize() const;
+    QSize getFullSize() const;
+    QRect getRegion() const;
+    bool isFullResolution() const;
+    bool isAnimated() const;
+
+    static QStringList getRawSuffixes();
+    static bool isRawFile(QString path);
+
+private:
+    QString path;
+    QSize maxSize;
+    QImage image;
+    //size of the image at full resolution, after EXIF orientation
+    QSize fullSize;
+    //part of the full resolution image covered by a region decode
+    QRect region;
+    QString errorString;
+    bool animated;
+    QSharedPointer<QAtomicInt> cancelFlag;
+    bool cancelled;
+
+    bool checkCancelled();
+    bool decodeCachedThumbnail();
+    unsigned short readOrientation() const;
+    static QRect alignToBlocks(QRect rect, QSize blockSize);
+    static QSize getJpegReduction(QSize size, QSize scaledSize);
+};
+
+#endif // IMAGEDECODER_H
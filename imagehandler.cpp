@@ -1,29 +1,81 @@
 #include "imagehandler.h"
 #include "convertimagesdialog.h"
 #include "cursormanager.h"
-#include "exifparser.h"
+#include "imageorientation.h"
+#include "orientationwriter.h"
 
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QFileDialog>
 #include <QInputDialog>
-#include <QImageReader>
 #include <QMovie>
+#include <QSettings>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <iostream>
 
-ImageHandler::ImageHandler() {
+//runs on a worker thread
+static ImageDecoder decodeRegion(QString path, QRect rect, double scale) {
+    ImageDecoder decoder(path);
+    decoder.decodeRegion(rect, scale);
+    return decoder;
+}
+
+//runs on a worker thread, the thumbnail cache is read from the disk
+static ImageDecoder decodeThumbnail(QString path) {
+    ImageDecoder decoder(path);
+    decoder.decodeThumbnail();
+    return decoder;
+}
+
+ImageHandler::ImageHandler() :
+    prefetcher(&imageCache)
+{
+    fullResolution = true;
+    pendingRegionScale = 1.0;
+    pendingLoadSuppressErrors = false;
+    orientation = 1;
+    writtenOrientation = 1;
+    rotated = false;
     connect(&fileSystemWatcher, SIGNAL(fileChanged(QString)), this, SLOT(reloadModifiedImage(QString)));
+    connect(&saveQueue, SIGNAL(saved(QString,QString)), this, SIGNAL(imageSaved(QString,QString)));
 }
 
-ImageHandler::ImageHandler(GraphicsView *view, QWidget *parent){
+ImageHandler::ImageHandler(GraphicsView *view, QWidget *parent) :
+    prefetcher(&imageCache)
+{
     this->view = view;
     this->parent = parent;
+    fullResolution = true;
+    pendingRegionScale = 1.0;
+    pendingLoadSuppressErrors = false;
+    orientation = 1;
+    writtenOrientation = 1;
+    rotated = false;
     connect(&fileSystemWatcher, SIGNAL(fileChanged(QString)), this, SLOT(reloadModifiedImage(QString)));
+    connect(&saveQueue, SIGNAL(saved(QString,QString)), this, SIGNAL(imageSaved(QString,QString)));
+    connect(view, SIGNAL(fullResolutionNeeded()), this, SLOT(loadFullResolution()));
+    connect(&loadWatcher, SIGNAL(finished()), this, SLOT(imageDecoded()));
+    connect(&thumbnailWatcher, SIGNAL(finished()), this, SLOT(thumbnailDecoded()));
+    connect(&fullResolutionWatcher, SIGNAL(finished()), this, SLOT(fullResolutionLoaded()));
+    connect(view, SIGNAL(regionNeeded(QRect,double)), this, SLOT(loadRegion(QRect,double)));
+    connect(&regionWatcher, SIGNAL(finished()), this, SLOT(regionLoaded()));
+}
+
+ImageHandler::~ImageHandler() {
+    //the decoder thread uses the image cache, running decoders stop early
+    cancelLoad();
+    prefetcher.clear();
+    loadWatcher.waitForFinished();
+    thumbnailWatcher.waitForFinished();
+    fullResolutionWatcher.waitForFinished();
+    regionWatcher.waitForFinished();
 }
 
 void ImageHandler::setFileQueue(QList<QUrl> queue) {
-    fileQueue = queue;
+    directoryIndex.setFiles(queue);
 }
 
 bool ImageHandler::load(QUrl url, bool suppressErrors){
@@ -32,79 +84,217 @@ bool ImageHandler::load(QUrl url, bool suppressErrors){
         return false;
     }
 
-    QImageReader reader(url.toLocalFile());
-    reader.setAllocationLimit(2000);
+    //large images are decoded at screen size first,
+    //the full resolution is only decoded when zooming in
+    const QSize maxSize = getDisplaySize();
+
+    //use the cached or prefetched image if there is one, otherwise decode it now
+    ImageDecoder decoder;
+    if(imageCache.find(url.toLocalFile(), decoder, maxSize)) {
+        //a decode of the previous image is not needed anymore
+        cancelLoad();
+    }
+    else {
+        requestLoad(url.toLocalFile(), suppressErrors, false);
 
-    image = reader.read();
+        //show the thumbnail until the decoder is done
+        if(loadWatcher.isRunning() && showThumbnail(url))
+            return true;
 
-    if(image.isNull() && !suppressErrors) {
+        //imageDecoded() ignores the job once it is not pending anymore
+        decoder = loadWatcher.result();
+        pendingLoadPath.clear();
+    }
+
+    if(decoder.getImage().isNull() && !suppressErrors) {
         QMessageBox::information(parent, "Error while loading image",
-                                 "Image not loaded!\nError: " + reader.errorString());
+                                 "Image not loaded!\nError: " + decoder.getErrorString());
         return false;
     }
 
-    if(reader.supportsAnimation()) {
+    show(url, decoder);
+
+    //start decoding the neighbours while the user looks at this image
+    prefetchNeighbours();
+    
+    return true;
+}
+
+//displays a decoded image and makes it the current one
+void ImageHandler::show(QUrl url, const ImageDecoder &decoder) {
+    image = decoder.getImage();
+
+    //store the path the image was loaded from (for saving later).
+    //Set before displaying it, the view may ask for its full resolution right away
+    imageUrl = url;
+    imageSize = decoder.getFullSize();
+    fullResolution = decoder.isFullResolution() || image.isNull();
+    orientation = 1;
+    writtenOrientation = 1;
+    rotated = false;
+    pendingRegion = QRect();
+
+    if(decoder.isAnimated()) {
         //animated gif
         QMovie *gif = new QMovie(url.toLocalFile());
         view->changeImage(gif, image);
     }
     else {
-        //normal image
-        //check exif data for image rotation
-
-        ExifParser exifParser(url);
-        if(exifParser.isValidExifData()) {
-            //rotate image
-
-            QTransform transform;
-
-            switch(exifParser.getOrientation()) {
-            case 1:
-                break;
-            case 2:
-                image = image.mirrored(true, false);
-                break;
-            case 3:
-                transform.rotate(180);
-                break;
-            case 4:
-                image = image.mirrored(false, true);
-                break;
-            case 5:
-                transform = transform.transposed();
-                break;
-            case 6:
-                transform.rotate(90);
-                break;
-            case 7:
-                transform.rotate(-90);
-                image = image.mirrored(false, true);
-                break;
-            case 8:
-                transform.rotate(270);
-                break;
-            }
-
-            image = image.transformed(transform);
-        }
-
+        //normal image, EXIF rotation was already applied by the decoder
         //display the image in the graphicsview
-        view->changeImage(image);
+        view->changeImage(image, decoder.getFullSize());
     }
 
-    //store the path the image was loaded from (for saving later)
-    imageUrl = url;
-    rotated = false;
+    //only lists the folder if it is not the one that is already indexed
+    if(!directoryIndex.isFileQueue())
+        directoryIndex.setDirectory(url.adjusted(QUrl::RemoveFilename), url);
 
     //add the image file to the fileSystemWatcher
     fileSystemWatcher.addPath(url.toLocalFile());
     
     //tell the mainwindow the image was loaded
     emit imageLoaded();
-    
+}
+
+//shows the embedded or cached thumbnail, stretched to the size of the image.
+//Only used by load(), whose callers need the size of the image right away
+bool ImageHandler::showThumbnail(QUrl url) {
+    ImageDecoder decoder(url.toLocalFile());
+    if(!decoder.decodeThumbnail())
+        return false;
+
+    show(url, decoder);
     return true;
 }
 
+//makes path the image that is shown next. A running decode of another image is
+//cancelled, if queue is set the new one starts as soon as it has stopped
+void ImageHandler::requestLoad(QString path, bool suppressErrors, bool queue) {
+    pendingLoadPath = path;
+    pendingLoadSuppressErrors = suppressErrors;
+
+    if(loadWatcher.isRunning()) {
+        if(loadingPath == path)
+            return;
+
+        if(loadCancelled)
+            loadCancelled->storeRelaxed(1);
+
+        //imageDecoded() starts the pending image
+        if(queue)
+            return;
+    }
+
+    startLoad();
+}
+
+//decodes the pending image, the cache stores it
+void ImageHandler::startLoad() {
+    const QUrl url = QUrl::fromLocalFile(pendingLoadPath);
+
+    QFuture<ImageDecoder> job;
+    if(!prefetcher.take(url, job, loadCancelled)) {
+        loadCancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+        job = QtConcurrent::run(&ImageCache::load, &imageCache, pendingLoadPath, getDisplaySize(), loadCancelled);
+    }
+
+    loadingPath = pendingLoadPath;
+    loadWatcher.setFuture(job);
+}
+
+//nothing is pending anymore, the running decode is stopped
+void ImageHandler::cancelLoad() {
+    pendingLoadPath.clear();
+
+    if(loadWatcher.isRunning() && loadCancelled)
+        loadCancelled->storeRelaxed(1);
+}
+
+//switches to another image of the folder without waiting for its decoder.
+//Key repeats come in faster than large images are decoded, so the requests
+//are coalesced: the images that were skipped in the meantime are never decoded
+void ImageHandler::navigate(QUrl url) {
+    ImageDecoder decoder;
+    if(imageCache.find(url.toLocalFile(), decoder, getDisplaySize())) {
+        cancelLoad();
+        show(url, decoder);
+        prefetchNeighbours();
+        return;
+    }
+
+    requestLoad(url.toLocalFile(), true, true);
+
+    //without a thumbnail the previous image stays until the decoder is done
+    requestThumbnail();
+}
+
+//reads the thumbnail of the pending image on a worker. Like the decodes, the
+//requests are coalesced: images that were skipped in the meantime get none
+void ImageHandler::requestThumbnail() {
+    if(thumbnailWatcher.isRunning() || pendingLoadPath.isEmpty()
+            || QUrl::fromLocalFile(pendingLoadPath) == imageUrl)
+        return;
+
+    thumbnailWatcher.setFuture(QtConcurrent::run(decodeThumbnail, pendingLoadPath));
+}
+
+void ImageHandler::thumbnailDecoded() {
+    const ImageDecoder decoder = thumbnailWatcher.result();
+
+    //the user moved on, the thumbnail of the latest image is read now
+    if(decoder.getPath() != pendingLoadPath) {
+        requestThumbnail();
+        return;
+    }
+
+    //the decoder might have been faster, then there is nothing pending anymore
+    const QUrl url = QUrl::fromLocalFile(decoder.getPath());
+    if(!decoder.getImage().isNull() && imageUrl != url)
+        show(url, decoder);
+}
+
+//position of the image that is shown next, the current one if nothing is pending
+int ImageHandler::getTargetIndex() const {
+    if(!pendingLoadPath.isEmpty())
+        return directoryIndex.indexOf(QUrl::fromLocalFile(pendingLoadPath));
+
+    return getCurrentIndex();
+}
+
+//the decoder of the pending image is done
+void ImageHandler::imageDecoded() {
+    ImageDecoder decoder = loadWatcher.result();
+    loadingPath.clear();
+
+    //the user might have moved on in the meantime, the latest image is decoded now
+    if(decoder.getPath() != pendingLoadPath || decoder.isCancelled()) {
+        if(!pendingLoadPath.isEmpty())
+            startLoad();
+        return;
+    }
+
+    const QUrl url = QUrl::fromLocalFile(pendingLoadPath);
+    pendingLoadPath.clear();
+
+    if(decoder.getImage().isNull() && !pendingLoadSuppressErrors) {
+        QMessageBox::information(parent, "Error while loading image",
+                                 "Image not loaded!\nError: " + decoder.getErrorString());
+    }
+    else if(imageUrl != url) {
+        //no thumbnail was displayed in the meantime
+        show(url, decoder);
+    }
+    else if(!decoder.getImage().isNull() && !fullResolution) {
+        //the thumbnail has the same size in scene coordinates, so the zoom and position are kept
+        replaceImage(decoder);
+        fullResolution = decoder.isFullResolution();
+
+        emit imageLoaded();
+    }
+
+    prefetchNeighbours();
+}
+
 //loads the next image
 void ImageHandler::next(){
     loadNeighbourImage(true);
@@ -116,14 +306,13 @@ void ImageHandler::previous(){
 }
 
 void ImageHandler::loadNeighbourImage(bool rightNeighbour) {
-    QList<QUrl> images = getImagesInDir(imageUrl.adjusted(QUrl::RemoveFilename));
-    
     //if there are no images or just one, do nothing
-    if(images.size() < 2)
+    if(directoryIndex.size() < 2)
         return;
     
-    // Find out where we currently are in the list
-    int current = images.indexOf(imageUrl);
+    // Find out where we currently are in the list,
+    //while the arrow keys are held that is the image that is decoded next
+    int current = getTargetIndex();
     
     //convert rightNeighbour to an int (left = -1, right = 1)
     int relativeIndex = -1;
@@ -133,10 +322,18 @@ void ImageHandler::loadNeighbourImage(bool rightNeighbour) {
     
     //if at beginning, take last element, if at end, take first element
     if(current < 0)
-        current = images.size() - 1;
-    else if(current > images.size() - 1)
+        current = directoryIndex.size() - 1;
+    else if(current > directoryIndex.size() - 1)
         current = 0;
 
+    loadIndex(current);
+}
+
+void ImageHandler::loadIndex(int index) {
+    QUrl url = directoryIndex.at(index);
+    if(!url.isValid())
+        return;
+
     //if image was rotated, ask if it should be saved
     if(rotated) {
         CursorManager::showCursor();
@@ -150,15 +347,166 @@ void ImageHandler::loadNeighbourImage(bool rightNeighbour) {
             save(imageUrl.toLocalFile(), 98);
         }
 
+        //only asked once, the next image might not be displayed yet
+        rotated = false;
+
         CursorManager::restoreCursorVisibility();
     }
     
     //remove current image from fileSystemWatcher
     fileSystemWatcher.removePath(imageUrl.toLocalFile());
 
-    //construct the new Url and load the file
-    //QUrl neighbourUrl = QUrl::fromLocalFile(imageUrl.adjusted(QUrl::RemoveFilename).toLocalFile() + images.at(current));
-    load(images.at(current), true);
+    navigate(url);
+}
+
+//loads the image at the given position in the current folder
+void ImageHandler::jumpTo(int index) {
+    if(index < 0 || index >= directoryIndex.size() || index == getTargetIndex())
+        return;
+
+    loadIndex(index);
+}
+
+void ImageHandler::first() {
+    jumpTo(0);
+}
+
+void ImageHandler::last() {
+    jumpTo(directoryIndex.size() - 1);
+}
+
+//decodes the images around the current one in the background
+void ImageHandler::prefetchNeighbours() {
+    int current = directoryIndex.indexOf(imageUrl);
+
+    if(directoryIndex.size() < 2 || current < 0) {
+        prefetcher.clear();
+        return;
+    }
+
+    QSettings qsettings( "simon", "imagepreview" );
+    const int radius = qsettings.value( "prefetch/radius", 2 ).toInt();
+
+    //alternate between right and left neighbours, closest ones first
+    QList<QUrl> neighbours;
+    for(int distance = 1; distance <= radius; ++distance) {
+        for(int direction = 1; direction >= -1; direction -= 2) {
+            QUrl url = directoryIndex.neighbour(current, direction * distance);
+            if(url != imageUrl && !neighbours.contains(url))
+                neighbours.append(url);
+        }
+    }
+
+    prefetcher.prefetch(neighbours, getDisplaySize());
+}
+
+//size that large images are decoded at before the user zooms in,
+//invalid if images should always be decoded at full resolution
+QSize ImageHandler::getDisplaySize() const {
+    QSettings qsettings( "simon", "imagepreview" );
+    if(!qsettings.value( "decode/displaySizeFirst", true ).toBool())
+        return QSize();
+
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    if(!screen)
+        return QSize();
+
+    return screen->size() * screen->devicePixelRatio();
+}
+
+//decodes the current image at full resolution in the background
+void ImageHandler::loadFullResolution() {
+    //wait for the reduced image if the thumbnail is displayed
+    if(fullResolution || !imageUrl.isValid() || !pendingLoadPath.isEmpty())
+        return;
+
+    //only the visible part of very large images is decoded
+    if(isRegionDecodeNeeded()) {
+        view->setRegionMode(true);
+        return;
+    }
+
+    if(fullResolutionWatcher.isRunning() && fullResolutionPath == imageUrl.toLocalFile())
+        return;
+
+    fullResolutionPath = imageUrl.toLocalFile();
+    fullResolutionWatcher.setFuture(QtConcurrent::run(&ImageCache::load, &imageCache, fullResolutionPath, QSize(), QSharedPointer<QAtomicInt>()));
+}
+
+void ImageHandler::fullResolutionLoaded() {
+    ImageDecoder decoder = fullResolutionWatcher.result();
+
+    //the user might have moved on to another image in the meantime
+    if(fullResolution || decoder.getPath() != imageUrl.toLocalFile() || decoder.getImage().isNull())
+        return;
+
+    //the file was rotated while it was decoded
+    if(decoder.getPath() != fullResolutionPath)
+        return;
+
+    //same size in scene coordinates, so the zoom and position are kept
+    replaceImage(decoder);
+    fullResolution = true;
+}
+
+//displays a new decode of the current file in place of image
+void ImageHandler::replaceImage(const ImageDecoder &decoder) {
+    image = decoder.getImage();
+
+    //the decoder already applied the orientation that was written to the file
+    orientation = ImageOrientation::compose(ImageOrientation::inverse(writtenOrientation), orientation);
+    writtenOrientation = 1;
+
+    view->changeImage(image, decoder.getFullSize(), orientation);
+}
+
+//full resolution size of image, before the orientation of the view
+QSize ImageHandler::getDecodedSize() const {
+    return ImageOrientation::isTransposed(orientation) ? imageSize.transposed() : imageSize;
+}
+
+//true if the full resolution of the current image would take too much memory
+bool ImageHandler::isRegionDecodeNeeded() const {
+    QSettings qsettings( "simon", "imagepreview" );
+    const qint64 threshold = qsettings.value( "decode/regionThresholdMP", 64 ).toLongLong() * 1000000;
+
+    return (qint64)imageSize.width() * imageSize.height() > threshold;
+}
+
+//decodes a part of the current image in the background, see GraphicsView::checkRegion()
+void ImageHandler::loadRegion(QRect rect, double scale) {
+    if(fullResolution || !imageUrl.isValid())
+        return;
+
+    //the view asks for a new region on every scroll step, only the latest one is decoded next
+    if(regionWatcher.isRunning()) {
+        pendingRegion = rect;
+        pendingRegionScale = scale;
+        return;
+    }
+
+    //the file may have been rotated since image was decoded
+    const QTransform transform = ImageOrientation::transform(writtenOrientation, getDecodedSize());
+    rect = transform.mapRect(QRectF(rect)).toAlignedRect();
+
+    regionWatcher.setFuture(QtConcurrent::run(decodeRegion, imageUrl.toLocalFile(), rect, scale));
+}
+
+void ImageHandler::regionLoaded() {
+    ImageDecoder decoder = regionWatcher.result();
+
+    if(!fullResolution && decoder.getPath() == imageUrl.toLocalFile()) {
+        //back to the pixels of image, the region is small
+        const QTransform transform = ImageOrientation::transform(writtenOrientation, getDecodedSize());
+        const QRect rect = transform.inverted().mapRect(QRectF(decoder.getRegion())).toAlignedRect();
+        view->showRegion(ImageOrientation::apply(decoder.getImage(), ImageOrientation::inverse(writtenOrientation)), rect);
+    }
+
+    if(pendingRegion.isValid()) {
+        QRect rect = pendingRegion;
+        pendingRegion = QRect();
+        loadRegion(rect, pendingRegionScale);
+    }
 }
 
 void ImageHandler::loadImage(QUrl url) {
@@ -166,34 +514,14 @@ void ImageHandler::loadImage(QUrl url) {
 }
 
 void ImageHandler::reloadModifiedImage(QString path) {
-    if(QImage(path).isNull())
+    //the file might still be in the process of being written.
+    //The cache key contains the new modification time, so load() finds this version
+    if(imageCache.load(path, getDisplaySize()).getImage().isNull())
         return;
 
     load(QUrl::fromLocalFile(path));
 }
 
-//returns a QStringList that contains all names of images in the folder
-QList<QUrl> ImageHandler::getImagesInDir(QUrl url) {
-    QStringList nameFilter;
-    nameFilter << "*.png" << "*.jpg" << "*.jpeg" << "*.tiff" << "*.tif"
-               << "*.ppm" << "*.bmp" << "*.xpm" << "*.psd" << "*.psb" << "*.gif";
-    
-    if(fileQueue.size() > 0) {
-        return fileQueue;
-    } else {
-        // Cycle through all images in the directory
-        QDir directory(url.toLocalFile());
-        // The entryList only contains filenames, not full paths
-        QStringList entryList = directory.entryList(nameFilter, QDir::Files);
-        // Construct a list of full QUrls
-        QList<QUrl> files;
-        for(int i = 0; i < entryList.size(); ++i) {
-            files.push_back(QUrl::fromLocalFile(url.toLocalFile() + entryList.at(i)));
-        }
-        return files;
-    }
-}
-
 const QImage& ImageHandler::getImage() const {
     return image;
 }
@@ -202,9 +530,32 @@ QUrl ImageHandler::getImageUrl() const {
     return imageUrl;
 }
 
-void ImageHandler::save(QString path, int quality) const {
-    if(!image.save(path, 0, quality))
-        QMessageBox::information(parent, "Error while saving Image", "Image not saved!");
+//size of the current image at full resolution
+QSize ImageHandler::getImageSize() const {
+    return imageSize;
+}
+
+//position of the current image in its folder (or file queue), -1 if unknown
+int ImageHandler::getCurrentIndex() const {
+    return directoryIndex.indexOf(imageUrl);
+}
+
+DirectoryIndex* ImageHandler::getDirectoryIndex() {
+    return &directoryIndex;
+}
+
+//queues the current image for saving, the rotation of the view is applied to
+//the pixels on the writer thread. The result is reported by imageSaved()
+void ImageHandler::save(QString path, int quality) {
+    if(fullResolution) {
+        saveQueue.save(image, orientation, path, quality);
+        return;
+    }
+
+    //decoded again at full resolution, with the orientation that was written to the file in the meantime
+    saveQueue.save(imageUrl.toLocalFile(),
+                   ImageOrientation::compose(ImageOrientation::inverse(writtenOrientation), orientation),
+                   path, quality);
 }
 
 void ImageHandler::save() {
@@ -245,17 +596,21 @@ void ImageHandler::deleteCurrent() {
 
     QUrl fileToTrash = imageUrl;
     
-    if(getImagesInDir(imageUrl.adjusted(QUrl::RemoveFilename)).size() > 1) {
+    if(directoryIndex.size() > 1) {
         next();
     }
     else {
         image = QImage();
         imageUrl = QUrl();
+        imageSize = QSize();
+        fullResolution = true;
         
         view->showText("No images in current folder.\nDrop image here to open it.");
     }
 
-    if(!trashHandler.moveToTrash(fileToTrash)) {
+    bool removed = trashHandler.moveToTrash(fileToTrash);
+
+    if(!removed) {
         //could not move image to trash
         //ask user if file should be removed directly
 
@@ -267,23 +622,53 @@ void ImageHandler::deleteCurrent() {
                                       QMessageBox::Yes|QMessageBox::No);
         if (reply == QMessageBox::Yes) {
             QFile file(fileToTrash.toLocalFile());
-            file.remove();
+            removed = file.remove();
         }
 
         CursorManager::restoreCursorVisibility();
     }
+
+    if(removed)
+        directoryIndex.remove(fileToTrash);
 }
 
 TrashHandler* ImageHandler::getTrashHandler() {
     return &trashHandler;
 }
 
+ImageCache* ImageHandler::getImageCache() {
+    return &imageCache;
+}
+
 void ImageHandler::rotateCurrent() {
-    QTransform transform;
-    transform.rotate(90);
-    image = image.transformed(transform);
+    if(!imageUrl.isValid())
+        return;
+
+    //only the transform of the view changes, orientation 6 is a clockwise rotation by 90 degrees
+    orientation = ImageOrientation::compose(orientation, 6);
+    imageSize.transpose();
+    view->setOrientation(orientation);
+
+    //JPEGs are rotated by their EXIF orientation, nothing has to be saved later.
+    //Not while a decode is pending, it might still read the old orientation
+    const QString path = imageUrl.toLocalFile();
+    if(!rotated && pendingLoadPath.isEmpty() && OrientationWriter::supportsFile(path)) {
+        //the change of the file is not a reason to load it again
+        fileSystemWatcher.removePath(path);
+        OrientationWriter writer(path);
+        const bool written = writer.rotateClockwise();
+        fileSystemWatcher.addPath(path);
+
+        if(written) {
+            writtenOrientation = ImageOrientation::compose(writtenOrientation, 6);
+
+            //a running full resolution decode still has the old orientation
+            fullResolutionPath.clear();
+            return;
+        }
+    }
 
-    view->changeImage(image);
+    //the rotated pixels may be saved later
     rotated = true;
 }
 
@@ -5,8 +5,13 @@
 #include <QUrl>
 #include <QObject>
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include "graphicsview.h"
 #include "trashhandler.h"
+#include "imageprefetcher.h"
+#include "imagecache.h"
+#include "directoryindex.h"
+#include "savequeue.h"
 
 class ImageHandler : public QObject
 {
@@ -15,41 +20,99 @@ class ImageHandler : public QObject
 public:
     ImageHandler();
     ImageHandler(GraphicsView *view, QWidget *parent);
+    ~ImageHandler();
     void setFileQueue(QList<QUrl> queue);
     bool load(QUrl url, bool suppressErrors = false);
     const QImage& getImage() const;
     QUrl getImageUrl() const;
-    void save(QString path, int quality = -1) const;
+    QSize getImageSize() const;
+    int getCurrentIndex() const;
+    DirectoryIndex* getDirectoryIndex();
+    void save(QString path, int quality = -1);
     TrashHandler* getTrashHandler();
     QSet<QUrl> getMarkedFiles() const { return markedFiles; };
     void clearMarkedFiles() { markedFiles.clear(); }
+    void unmarkFile(QUrl url) { markedFiles.remove(url); }
+    ImageCache* getImageCache();
 
 private:
     QWidget *parent;
     GraphicsView *view;
     QImage image;
     QUrl imageUrl;
-    QList<QUrl> fileQueue;
+    QSize imageSize;
+    //false while image is a reduced resolution preview
+    bool fullResolution;
+    //decoder of the image while its thumbnail (or the previous image) is displayed.
+    //Only one image is decoded at a time, pendingLoadPath is the one that is shown next
+    QFutureWatcher<ImageDecoder> loadWatcher;
+    QString loadingPath;
+    QSharedPointer<QAtomicInt> loadCancelled;
+    QString pendingLoadPath;
+    bool pendingLoadSuppressErrors;
+    //reads the thumbnail of the pending image while navigating, one at a time
+    QFutureWatcher<ImageDecoder> thumbnailWatcher;
+    QFutureWatcher<ImageDecoder> fullResolutionWatcher;
+    QString fullResolutionPath;
+    QFutureWatcher<ImageDecoder> regionWatcher;
+    //region that was requested while another one was decoded
+    QRect pendingRegion;
+    double pendingRegionScale;
+    DirectoryIndex directoryIndex;
     QSet<QUrl> markedFiles;
     QFileSystemWatcher fileSystemWatcher;
     TrashHandler trashHandler;
+    //declared before the prefetcher, whose worker threads use it
+    ImageCache imageCache;
+    ImagePrefetcher prefetcher;
+    SaveQueue saveQueue;
+    //the view displays image with this orientation, its pixels are only rotated when saving
+    unsigned short orientation;
+    //the part of the orientation that was written to the file after image was decoded
+    unsigned short writtenOrientation;
+    //true if a rotation was not written to the file
     bool rotated;
     
-    QList<QUrl> getImagesInDir(QUrl url);
+    void show(QUrl url, const ImageDecoder &decoder);
+    void replaceImage(const ImageDecoder &decoder);
+    QSize getDecodedSize() const;
+    bool showThumbnail(QUrl url);
+    void requestThumbnail();
+    void requestLoad(QString path, bool suppressErrors, bool queue);
+    void startLoad();
+    void cancelLoad();
+    void navigate(QUrl url);
+    int getTargetIndex() const;
     void loadNeighbourImage(bool rightNeighbour);
+    void loadIndex(int index);
+    void prefetchNeighbours();
+    QSize getDisplaySize() const;
+    bool isRegionDecodeNeeded() const;
 
 public slots:
     void loadImage(QUrl url);
     void reloadModifiedImage(QString path);
     void next();
     void previous();
+    void first();
+    void last();
+    void jumpTo(int index);
     void save();
     void deleteCurrent();
     void rotateCurrent();
     void toggleMarkCurrentImage();
+    void loadFullResolution();
+    void loadRegion(QRect rect, double scale);
+
+private slots:
+    void imageDecoded();
+    void thumbnailDecoded();
+    void fullResolutionLoaded();
+    void regionLoaded();
     
 signals:
     void imageLoaded();
+    void imageSaved(QString path, QString errorString);
 };
 
 #endif // IMAGEHANDLER_H
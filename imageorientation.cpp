@@ -0,0 +1,268 @@
+#include "imageorientation.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct Pixel24 {
+    uchar bytes[3];
+};
+
+//where pixel (0, 0) of the source is stored in the destination (in bytes)
+//and how far the destination moves for one pixel in x and y in the source
+struct Mapping {
+    qptrdiff origin;
+    qptrdiff stepX;
+    qptrdiff stepY;
+};
+
+}
+
+static Mapping makeMapping(unsigned short orientation, int width, int height, int pixelBytes, qptrdiff destStride) {
+    const qptrdiff lastX = (qptrdiff)(width - 1) * pixelBytes;
+    const qptrdiff lastY = (qptrdiff)(height - 1) * destStride;
+    //the destination is transposed for orientations 5 to 8
+    const qptrdiff lastRow = (qptrdiff)(width - 1) * destStride;
+    const qptrdiff lastColumn = (qptrdiff)(height - 1) * pixelBytes;
+
+    Mapping mapping;
+    switch(orientation) {
+    case 2:
+        mapping = { lastX, -pixelBytes, destStride };
+        break;
+    case 3:
+        mapping = { lastY + lastX, -pixelBytes, -destStride };
+        break;
+    case 4:
+        mapping = { lastY, pixelBytes, -destStride };
+        break;
+    case 5:
+        mapping = { 0, destStride, pixelBytes };
+        break;
+    case 6:
+        mapping = { lastColumn, destStride, -pixelBytes };
+        break;
+    case 7:
+        mapping = { lastRow + lastColumn, -destStride, -pixelBytes };
+        break;
+    case 8:
+        mapping = { lastRow, -destStride, pixelBytes };
+        break;
+    default:
+        mapping = { 0, pixelBytes, destStride };
+        break;
+    }
+
+    return mapping;
+}
+
+//copies the source pixels in [x0, x1) x [y0, y1) to their destination
+template <typename T>
+static void copyPixels(const QImage &source, uchar *destBits, const Mapping &mapping, int x0, int x1, int y0, int y1) {
+    for(int y = y0; y < y1; ++y) {
+        const T *src = reinterpret_cast<const T*>(source.constScanLine(y)) + x0;
+        uchar *dst = destBits + mapping.origin + y * mapping.stepY + x0 * mapping.stepX;
+
+        for(int x = x0; x < x1; ++x) {
+            *reinterpret_cast<T*>(dst) = *src++;
+            dst += mapping.stepX;
+        }
+    }
+}
+
+//walks the source in square blocks, so the rows of the destination that a
+//transposing orientation writes to stay in the cache
+template <typename T>
+static void copyBlocks(const QImage &source, QImage &dest, const Mapping &mapping, bool transposed) {
+    const int width = source.width();
+    const int height = source.height();
+    uchar *destBits = dest.bits();
+
+    //mirroring keeps rows together, the whole row is one block
+    const int blockWidth = transposed ? ImageOrientation::blockSize : width;
+
+    for(int blockY = 0; blockY < height; blockY += ImageOrientation::blockSize) {
+        const int endY = qMin(blockY + ImageOrientation::blockSize, height);
+        for(int blockX = 0; blockX < width; blockX += blockWidth)
+            copyPixels<T>(source, destBits, mapping, blockX, qMin(blockX + blockWidth, width), blockY, endY);
+    }
+}
+
+#ifdef __SSE2__
+//32 bit pixels with orientations 5 to 8: 4x4 pixels are transposed in registers
+static void copyBlocksSse2(const QImage &source, QImage &dest, const Mapping &mapping, unsigned short orientation) {
+    const int width = source.width();
+    const int height = source.height();
+    uchar *destBits = dest.bits();
+    const qptrdiff destStride = dest.bytesPerLine();
+
+    //orientations 6 and 7 reverse the rows of the transposed block,
+    //7 and 8 store the columns of the source from the last row up
+    const bool reverse = orientation == 6 || orientation == 7;
+    const bool flipRows = orientation == 7 || orientation == 8;
+
+    for(int blockY = 0; blockY < height; blockY += ImageOrientation::blockSize) {
+        const int endY = qMin(blockY + ImageOrientation::blockSize, height);
+        const int vectorEndY = blockY + (endY - blockY) / 4 * 4;
+
+        for(int blockX = 0; blockX < width; blockX += ImageOrientation::blockSize) {
+            const int endX = qMin(blockX + ImageOrientation::blockSize, width);
+            const int vectorEndX = blockX + (endX - blockX) / 4 * 4;
+
+            for(int y = blockY; y < vectorEndY; y += 4) {
+                const quint32 *row0 = reinterpret_cast<const quint32*>(source.constScanLine(y));
+                const quint32 *row1 = reinterpret_cast<const quint32*>(source.constScanLine(y + 1));
+                const quint32 *row2 = reinterpret_cast<const quint32*>(source.constScanLine(y + 2));
+                const quint32 *row3 = reinterpret_cast<const quint32*>(source.constScanLine(y + 3));
+                const int destX = reverse ? height - 4 - y : y;
+
+                for(int x = blockX; x < vectorEndX; x += 4) {
+                    const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x));
+                    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x));
+                    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row2 + x));
+                    const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row3 + x));
+
+                    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+                    //column i of the source block
+                    __m128i columns[4] = {
+                        _mm_unpacklo_epi64(t0, t1),
+                        _mm_unpackhi_epi64(t0, t1),
+                        _mm_unpacklo_epi64(t2, t3),
+                        _mm_unpackhi_epi64(t2, t3)
+                    };
+
+                    for(int i = 0; i < 4; ++i) {
+                        if(reverse)
+                            columns[i] = _mm_shuffle_epi32(columns[i], _MM_SHUFFLE(0, 1, 2, 3));
+
+                        const int destY = flipRows ? width - 1 - (x + i) : x + i;
+                        quint32 *dst = reinterpret_cast<quint32*>(destBits + destY * destStride) + destX;
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), columns[i]);
+                    }
+                }
+            }
+
+            //the rest of the block if its size is not a multiple of 4
+            copyPixels<quint32>(source, destBits, mapping, vectorEndX, endX, blockY, vectorEndY);
+            copyPixels<quint32>(source, destBits, mapping, blockX, endX, vectorEndY, endY);
+        }
+    }
+}
+#endif
+
+//returns the image as it should be displayed according to the EXIF orientation
+QImage ImageOrientation::apply(const QImage &image, unsigned short orientation) {
+    if(orientation < 2 || orientation > 8 || image.isNull())
+        return image;
+
+    const bool transposed = isTransposed(orientation);
+    const int depth = image.depth();
+
+    //1 bit images are not byte aligned, they take the slow path
+    if(depth != 8 && depth != 16 && depth != 24 && depth != 32 && depth != 64)
+        return image.transformed(transform(orientation, image.size()));
+
+    QImage dest(transposed ? image.size().transposed() : image.size(), image.format());
+    if(dest.isNull())
+        return image;
+
+    dest.setColorTable(image.colorTable());
+    dest.setColorSpace(image.colorSpace());
+    dest.setDevicePixelRatio(image.devicePixelRatio());
+    dest.setDotsPerMeterX(transposed ? image.dotsPerMeterY() : image.dotsPerMeterX());
+    dest.setDotsPerMeterY(transposed ? image.dotsPerMeterX() : image.dotsPerMeterY());
+    for(const QString &key : image.textKeys())
+        dest.setText(key, image.text(key));
+
+    const Mapping mapping = makeMapping(orientation, image.width(), image.height(), depth / 8, dest.bytesPerLine());
+
+    switch(depth) {
+    case 8:
+        copyBlocks<quint8>(image, dest, mapping, transposed);
+        break;
+    case 16:
+        copyBlocks<quint16>(image, dest, mapping, transposed);
+        break;
+    case 24:
+        copyBlocks<Pixel24>(image, dest, mapping, transposed);
+        break;
+    case 32:
+#ifdef __SSE2__
+        if(transposed) {
+            copyBlocksSse2(image, dest, mapping, orientation);
+            break;
+        }
+#endif
+        copyBlocks<quint32>(image, dest, mapping, transposed);
+        break;
+    case 64:
+        copyBlocks<quint64>(image, dest, mapping, transposed);
+        break;
+    }
+
+    return dest;
+}
+
+//maps pixels of an image with the given size, as stored in the file,
+//to the pixels of the displayed image
+QTransform ImageOrientation::transform(unsigned short orientation, QSize size) {
+    const int w = size.width();
+    const int h = size.height();
+
+    switch(orientation) {
+    case 2:
+        return QTransform(-1, 0, 0, 1, w, 0);
+    case 3:
+        return QTransform(-1, 0, 0, -1, w, h);
+    case 4:
+        return QTransform(1, 0, 0, -1, 0, h);
+    case 5:
+        return QTransform(0, 1, 1, 0, 0, 0);
+    case 6:
+        return QTransform(0, 1, -1, 0, h, 0);
+    case 7:
+        return QTransform(0, -1, -1, 0, h, w);
+    case 8:
+        return QTransform(0, -1, 1, 0, 0, w);
+    default:
+        return QTransform();
+    }
+}
+
+//orientations 5 to 8 swap width and height
+bool ImageOrientation::isTransposed(unsigned short orientation) {
+    return orientation >= 5 && orientation <= 8;
+}
+
+//the orientation that has the same effect as applying first, then second
+unsigned short ImageOrientation::compose(unsigned short first, unsigned short second) {
+    //the translation depends on the size, the rest is the same for all sizes
+    const QTransform combined = transform(first, QSize(1, 1)) * transform(second, QSize(1, 1));
+    for(unsigned short orientation = 1; orientation <= 8; ++orientation) {
+        const QTransform candidate = transform(orientation, QSize(1, 1));
+        if(candidate.m11() == combined.m11() && candidate.m12() == combined.m12()
+                && candidate.m21() == combined.m21() && candidate.m22() == combined.m22())
+            return orientation;
+    }
+
+    return 1;
+}
+
+//the orientation that undoes the given one
+unsigned short ImageOrientation::inverse(unsigned short orientation) {
+    //all of them are their own inverse, except for the rotations by 90 degrees
+    if(orientation == 6)
+        return 8;
+    if(orientation == 8)
+        return 6;
+    if(orientation > 8)
+        return 1;
+
+    return orientation;
+}
@@ -0,0 +1,25 @@
+#ifndef IMAGEORIENTATION_H
+#define IMAGEORIENTATION_H
+
+#include <QImage>
+#include <QSize>
+#include <QTransform>
+
+//applies the 8 EXIF orientations (mirroring and rotating by multiples of
+//90 degrees) to an image in a single pass. The pixels are copied directly
+//into the destination in cache sized blocks, instead of going through
+//QImage::mirrored() and the generic affine path of QImage::transformed().
+class ImageOrientation
+{
+public:
+    static QImage apply(const QImage &image, unsigned short orientation);
+    static QTransform transform(unsigned short orientation, QSize size);
+    static bool isTransposed(unsigned short orientation);
+    static unsigned short compose(unsigned short first, unsigned short second);
+    static unsigned short inverse(unsigned short orientation);
+
+    //edge length of the blocks the image is copied in, in pixels
+    static const int blockSize = 64;
+};
+
+#endif // IMAGEORIENTATION_H
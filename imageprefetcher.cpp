@@ -0,0 +1,61 @@
+#include "imageprefetcher.h"
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QThread>
+
+#include <utility>
+
+ImagePrefetcher::ImagePrefetcher(ImageCache *cache, QObject *parent) :
+    QObject(parent),
+    cache(cache)
+{
+    //leave one core for the GUI thread
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+ImagePrefetcher::~ImagePrefetcher() {
+    pool.waitForDone();
+}
+
+//replaces the set of prefetched images with the given urls,
+//decoded to fit into maxSize (or at full resolution if it is invalid)
+void ImagePrefetcher::prefetch(const QList<QUrl> &urls, QSize maxSize) {
+    //forget images that are no longer wanted
+    QMutableHashIterator<QUrl, Job> it(jobs);
+    while(it.hasNext()) {
+        it.next();
+        if(!urls.contains(it.key())) {
+            it.value().cancelFlag->storeRelaxed(1);
+            it.remove();
+        }
+    }
+
+    for(const QUrl &url : urls) {
+        //images that are already cached don't need to be decoded again
+        if(!jobs.contains(url) && !cache->contains(url.toLocalFile(), maxSize)) {
+            Job job;
+            job.cancelFlag = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+            job.future = QtConcurrent::run(&pool, &ImageCache::load, cache, url.toLocalFile(), maxSize, job.cancelFlag);
+            jobs.insert(url, job);
+        }
+    }
+}
+
+//returns true and hands over the job and its cancel flag if the image is being
+//prefetched. The decoder might still be running, so it doesn't have to start over.
+bool ImagePrefetcher::take(QUrl url, QFuture<ImageDecoder> &job, QSharedPointer<QAtomicInt> &cancelFlag) {
+    if(!jobs.contains(url))
+        return false;
+
+    const Job taken = jobs.take(url);
+    job = taken.future;
+    cancelFlag = taken.cancelFlag;
+    return true;
+}
+
+void ImagePrefetcher::clear() {
+    for(const Job &job : std::as_const(jobs))
+        job.cancelFlag->storeRelaxed(1);
+
+    jobs.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGEPREFETCHER_H
+#define IMAGEPREFETCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QUrl>
+#include <QFuture>
+#include <QThreadPool>
+#include <QSize>
+#include "imagedecoder.h"
+#include "imagecache.h"
+
+//decodes images that are likely to be shown next on worker threads,
+//so switching to them does not have to wait for the decoder.
+//Decoders of images that are no longer wanted are cancelled.
+class ImagePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImagePrefetcher(ImageCache *cache, QObject *parent = 0);
+    ~ImagePrefetcher();
+    void prefetch(const QList<QUrl> &urls, QSize maxSize = QSize());
+    bool take(QUrl url, QFuture<ImageDecoder> &job, QSharedPointer<QAtomicInt> &cancelFlag);
+    void clear();
+
+private:
+    struct Job {
+        QFuture<ImageDecoder> future;
+        QSharedPointer<QAtomicInt> cancelFlag;
+    };
+
+    ImageCache *cache;
+    QHash<QUrl, Job> jobs;
+    QThreadPool pool;
+};
+
+#endif // IMAGEPREFETCHER_H
@@ -1,8 +1,13 @@
 #include "mainwindow.h"
+#include "commandlineconverter.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    //batch conversion without a window
+    if(CommandLineConverter::isRequested(argc, argv))
+        return CommandLineConverter::run(argc, argv);
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -5,6 +5,7 @@
 #include "restoretrashdialog.h"
 #include "helpdialog.h"
 #include "cursormanager.h"
+#include "thumbnailcache.h"
 
 #include <QFileInfo>
 #include <QDesktopServices>
@@ -15,9 +16,25 @@
 #include <QMimeData>
 #include <QDrag>
 #include <QCloseEvent>
+#include <QInputDialog>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <iostream>
 
+//runs on a worker thread. Returns the cached thumbnail of the image, or
+//stores one made from the loaded image. Previews smaller than a thumbnail
+//(an EXIF thumbnail shown while decoding) are used, but not stored.
+static QImage loadThumbnail(QString path, QImage image, QSize fullSize) {
+    QImage thumbnail = ThumbnailCache::load(path);
+    if(!thumbnail.isNull())
+        return thumbnail;
+
+    if(image.size() == fullSize || qMax(image.width(), image.height()) >= ThumbnailCache::NORMAL)
+        return ThumbnailCache::save(path, image);
+
+    return image;
+}
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -34,6 +51,13 @@ MainWindow::MainWindow(QWidget *parent) :
     
     //initialize imageHandler
     imageHandler = new ImageHandler(ui->graphicsView, this);
+
+    //initialize thumbnails
+    thumbnailModel = new ThumbnailModel(imageHandler->getDirectoryIndex(), this);
+    ui->thumbnailView->setThumbnailModel(thumbnailModel);
+    QSettings qsettings( "simon", "imagepreview" );
+    filmstripVisible = qsettings.value( "mainwindow/filmstrip", false ).toBool();
+    ui->thumbnailView->setVisible(filmstripVisible);
     
     //connect signals/slots
     //graphicsview drag and drop
@@ -42,17 +66,37 @@ MainWindow::MainWindow(QWidget *parent) :
     //keyboard shortcuts
     connect(ui->graphicsView, SIGNAL(keyLeftPressed()), imageHandler, SLOT(previous()));
     connect(ui->graphicsView, SIGNAL(keyRightPressed()), imageHandler, SLOT(next()));
+    connect(ui->graphicsView, SIGNAL(keyHomePressed()), imageHandler, SLOT(first()));
+    connect(ui->graphicsView, SIGNAL(keyEndPressed()), imageHandler, SLOT(last()));
+    connect(ui->graphicsView, SIGNAL(controlGPressed()), this, SLOT(goToImage()));
     connect(ui->graphicsView, SIGNAL(controlSPressed()), imageHandler, SLOT(save()));
     connect(ui->graphicsView, SIGNAL(controlCPressed()), this, SLOT(convertImages()));
     connect(ui->graphicsView, SIGNAL(deletePressed()), imageHandler, SLOT(deleteCurrent()));
     connect(ui->graphicsView, SIGNAL(rotatePressed()), imageHandler, SLOT(rotateCurrent()));
     connect(ui->graphicsView, SIGNAL(markPressed()), this, SLOT(toggleMarkCurrentImage()));
     connect(ui->graphicsView, SIGNAL(copyMarkedPressed()), this, SLOT(copyMarkedImages()));
+    connect(ui->graphicsView, SIGNAL(filmstripPressed()), this, SLOT(toggleFilmstrip()));
+    connect(ui->graphicsView, SIGNAL(gridPressed()), this, SLOT(toggleGrid()));
+    //thumbnails
+    connect(ui->thumbnailView, SIGNAL(imageSelected(int)), this, SLOT(thumbnailSelected(int)));
+    connect(ui->thumbnailView, SIGNAL(closeRequested()), this, SLOT(toggleGrid()));
     //doubleclick -> fullscreen
     connect(ui->graphicsView, SIGNAL(doubleClicked()), this, SLOT(toggleFullscreen()));
     //display image info, update scale factor display
     connect(imageHandler, SIGNAL(imageLoaded()), this, SLOT(initImageLoaded()));
+    connect(&iconWatcher, SIGNAL(finished()), this, SLOT(iconLoaded()));
+    //saving runs in the background, the result is shown next to the image info
+    statusTimer.setSingleShot(true);
+    connect(imageHandler, SIGNAL(imageSaved(QString,QString)), this, SLOT(imageSaved(QString,QString)));
+    connect(&statusTimer, SIGNAL(timeout()), ui->label_status, SLOT(clear()));
+    //copying marked images
+    copyProgress = 0;
+    closeAfterCopy = false;
+    connect(&copyEngine, SIGNAL(progress()), this, SLOT(updateCopyProgress()));
+    connect(&copyEngine, SIGNAL(fileFinished(int)), this, SLOT(updateCopyProgress()));
+    connect(&copyEngine, SIGNAL(finished()), this, SLOT(copyFinished()));
     connect(ui->graphicsView, SIGNAL(scaleChanged(double)), this, SLOT(displayImageInfo()));
+    connect(imageHandler->getDirectoryIndex(), SIGNAL(changed()), this, SLOT(displayImageInfo()));
     //open in file browser
     connect(ui->pushButton_openFolder, SIGNAL(clicked()), this, SLOT(openFolder()));
     //drag image (copy to folder)
@@ -74,6 +118,13 @@ MainWindow::MainWindow(QWidget *parent) :
     
     // Show the window to avoid bug where image is not scaled properly when passed as argument
     QMainWindow::show();
+
+    //images deleted in a session that didn't end normally can still be restored
+    if(!imageHandler->getTrashHandler()->isEmpty()) {
+        RestoreTrashDialog dialog(this, imageHandler->getTrashHandler(), false);
+        if(dialog.exec() == QDialog::Accepted)
+            imageHandler->getTrashHandler()->emptyTrash();
+    }
     
     //if the program was opened via "open with" by the OS, extract the image path from the arguments
     QStringList args = QCoreApplication::arguments();
@@ -92,8 +143,8 @@ MainWindow::MainWindow(QWidget *parent) :
         
         if(!isFullScreen()) {
             //adapt the size of the window to the image if it is smaller than the screen
-            int imageWidth = imageHandler->getImage().width();
-            int imageHeight = imageHandler->getImage().height();
+            int imageWidth = imageHandler->getImageSize().width();
+            int imageHeight = imageHandler->getImageSize().height();
             
             const QSize screenSize = QGuiApplication::primaryScreen()->size();
             int screenWidth = screenSize.width();
@@ -109,6 +160,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    iconWatcher.waitForFinished();
     delete ui;
     delete imageHandler;
 }
@@ -124,28 +176,68 @@ void MainWindow::initImageLoaded() {
     
     displayImageInfo();
     
-    //use loaded image as application icon
-    QIcon icon(QPixmap::fromImage(image.scaled(64, 64, Qt::KeepAspectRatioByExpanding)));
-    this->setWindowIcon(icon);
+    ui->thumbnailView->setCurrentImage(imageHandler->getCurrentIndex());
+
+    //use the thumbnail of the loaded image as application icon
+    iconWatcher.setFuture(QtConcurrent::run(loadThumbnail, imageUrl.toLocalFile(), image, imageHandler->getImageSize()));
     //use the name of the loaded image as window title
     this->setWindowTitle(QFileInfo(imageUrl.toLocalFile()).fileName() + " - Image Preview Tool");
 }
 
+void MainWindow::iconLoaded() {
+    const QImage thumbnail = iconWatcher.result();
+    if(!thumbnail.isNull())
+        this->setWindowIcon(QIcon(QPixmap::fromImage(thumbnail.scaled(64, 64, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation))));
+}
+
 //creates the info text for the label and displays it
+void MainWindow::imageSaved(QString path, QString errorString) {
+    const QString name = QFileInfo(path).fileName();
+
+    //errors stay a little longer, there is no dialog for them
+    if(errorString.isEmpty()) {
+        ui->label_status->setText("Saved " + name);
+        statusTimer.start(5000);
+    }
+    else {
+        ui->label_status->setText("Could not save " + name + ": " + errorString);
+        statusTimer.start(15000);
+    }
+}
+
 void MainWindow::displayImageInfo() {
-    const QImage& image = imageHandler->getImage();
+    //full resolution size, the displayed image might be a reduced preview
+    const QSize imageSize = imageHandler->getImageSize();
     QUrl imageUrl = imageHandler->getImageUrl();
     
     QFileInfo fileInfo(imageUrl.toLocalFile());
     qint64 sizeBytes = fileInfo.size();
     double sizeKilobytes = (double)sizeBytes / 1024.0;
 
-    ui->label_size->setText(QString::number(image.width()) + " x " + QString::number(image.height()) + " px");
+    ui->label_size->setText(QString::number(imageSize.width()) + " x " + QString::number(imageSize.height()) + " px");
     ui->label_fileSize->setText(QString::number(sizeKilobytes, 'f', 2) + " kB");
+
+    //position in the current folder
+    const int index = imageHandler->getCurrentIndex();
+    const int count = imageHandler->getDirectoryIndex()->size();
+    QString position = index < 0 ? "" : QString::number(index + 1) + " / " + QString::number(count);
+    //huge folders are listed in the background
+    if(imageHandler->getDirectoryIndex()->isScanning())
+        position += " (listing folder...)";
+    ui->label_position->setText(position);
     
     ui->doubleSpinBox_scale->setValue(ui->graphicsView->getScaleFactor() * 100.0);
 
     ui->label_marked->setText(imageHandler->getMarkedFiles().contains(imageUrl) ? "(Marked)" : "");
+
+    //decoded image cache statistics, useful to choose the cache/budgetMB setting
+    const ImageCache *cache = imageHandler->getImageCache();
+    ui->label_size->setToolTip("File dimensions\n\nImage cache: "
+                               + QString::number(cache->getUsedBytes() / (1024 * 1024)) + " of "
+                               + QString::number(cache->getBudget() / (1024 * 1024)) + " MB used\n"
+                               + QString::number(cache->getHits()) + " hits, "
+                               + QString::number(cache->getMisses()) + " misses, "
+                               + QString::number(cache->getEvictions()) + " evictions");
 }
 
 void MainWindow::openFolder() {
@@ -176,7 +268,8 @@ void MainWindow::convertImages() {
     QList<QUrl> urls = QFileDialog::getOpenFileUrls(this,
                                                     "Select Images to Convert",
                                                     imageHandler->getImageUrl().adjusted(QUrl::RemoveFilename),
-                                                    "Image Formats (*.png *.jpg *.jpeg *.tiff *.ppm *.bmp *.xpm *.psd *.psb *.gif)");
+                                                    "Image Formats (*.png *.jpg *.jpeg *.tiff *.ppm *.bmp *.xpm *.psd *.psb *.gif "
+                                                    "*.cr2 *.nef *.nrw *.arw *.dng)");
     
     if(urls.size() == 0)
         return;
@@ -192,6 +285,13 @@ void MainWindow::resizeEvent(QResizeEvent *event) {
 void MainWindow::closeEvent(QCloseEvent* event) {
     CursorManager::showCursor();
 
+    //closed once the marked images are copied
+    if(copyEngine.isRunning()) {
+        closeAfterCopy = true;
+        event->ignore();
+        return;
+    }
+
     QSet<QUrl> markedFiles = imageHandler->getMarkedFiles();
     if (!markedFiles.isEmpty()) {
         const QString numMarkedFiles = QString::number(markedFiles.size());
@@ -200,6 +300,12 @@ void MainWindow::closeEvent(QCloseEvent* event) {
                                                       "Copy " + numMarkedFiles + " marked files before closing?"))
         {
             copyMarkedImages();
+
+            if(copyEngine.isRunning()) {
+                closeAfterCopy = true;
+                event->ignore();
+                return;
+            }
         }
     }
 
@@ -211,6 +317,8 @@ void MainWindow::closeEvent(QCloseEvent* event) {
             event->ignore();
             return;
         }
+
+        imageHandler->getTrashHandler()->emptyTrash();
     }
 
     //exit fullscreen
@@ -223,12 +331,15 @@ void MainWindow::closeEvent(QCloseEvent* event) {
 void MainWindow::toggleFullscreen() {
     if(isFullScreen()) {
         ui->widget_infobar->show();
+        ui->thumbnailView->setVisible(filmstripVisible || ui->thumbnailView->isGridMode());
         this->setWindowState(Qt::WindowNoState);
         CursorManager::showCursor();
     }
     else
     {
         ui->widget_infobar->hide();
+        if(!ui->thumbnailView->isGridMode())
+            ui->thumbnailView->hide();
         this->setWindowState(Qt::WindowFullScreen);
         CursorManager::hideCursor();
     }
@@ -250,6 +361,7 @@ void MainWindow::writePositionSettings()
     qsettings.setValue( "geometry", saveGeometry() );
     qsettings.setValue( "savestate", saveState() );
     qsettings.setValue( "maximized", isMaximized() );
+    qsettings.setValue( "filmstrip", filmstripVisible );
     if ( !isMaximized() ) {
         qsettings.setValue( "pos", pos() );
         qsettings.setValue( "size", size() );
@@ -290,6 +402,54 @@ void MainWindow::toggleMarkCurrentImage() {
     displayImageInfo();
 }
 
+//asks for a position in the current folder and displays the image there
+void MainWindow::goToImage() {
+    const int count = imageHandler->getDirectoryIndex()->size();
+    if(count == 0)
+        return;
+
+    CursorManager::showCursor();
+
+    bool ok;
+    int position = QInputDialog::getInt(this, "Go to Image", "Image number:",
+                                        imageHandler->getCurrentIndex() + 1, 1, count, 1, &ok);
+    if(ok)
+        imageHandler->jumpTo(position - 1);
+
+    CursorManager::restoreCursorVisibility();
+}
+
+//shows or hides the thumbnails below the image
+void MainWindow::toggleFilmstrip() {
+    filmstripVisible = !filmstripVisible;
+    if(!isFullScreen())
+        ui->thumbnailView->setVisible(filmstripVisible);
+}
+
+//shows the thumbnails of the folder in a grid instead of the image, or the image again
+void MainWindow::toggleGrid() {
+    if(ui->thumbnailView->isGridMode()) {
+        ui->thumbnailView->setGridMode(false);
+        ui->thumbnailView->setVisible(filmstripVisible && !isFullScreen());
+        ui->graphicsView->show();
+        ui->graphicsView->setFocus();
+    }
+    else {
+        ui->graphicsView->hide();
+        ui->thumbnailView->setGridMode(true);
+        ui->thumbnailView->show();
+        ui->thumbnailView->setFocus();
+    }
+}
+
+void MainWindow::thumbnailSelected(int index) {
+    //the grid is left for the selected image
+    if(ui->thumbnailView->isGridMode())
+        toggleGrid();
+
+    imageHandler->jumpTo(index);
+}
+
 void MainWindow::copyMarkedImages() {
     const QSet<QUrl> markedFiles = imageHandler->getMarkedFiles();
 
@@ -300,31 +460,96 @@ void MainWindow::copyMarkedImages() {
         return;
     }
 
+    if (copyEngine.isRunning())
+        return;
+
     const QUrl targetDirUrl = QFileDialog::getExistingDirectoryUrl(this,
                                                                    "Select where to copy the marked images to",
                                                                    imageHandler->getImageUrl().adjusted(QUrl::RemoveFilename));
 
     if (targetDirUrl.isValid()) {
-        int errors = 0;
+        QStringList paths;
+        for (const QUrl &url : markedFiles)
+            paths.append(url.toLocalFile());
+
+        //the files are copied in the background, the dialog doesn't block the viewer
+        if (!copyProgress) {
+            copyProgress = new QProgressDialog(this);
+            copyProgress->setWindowTitle("Copying marked images");
+            copyProgress->setWindowModality(Qt::NonModal);
+            copyProgress->setAutoClose(false);
+            copyProgress->setAutoReset(false);
+            copyProgress->setRange(0, 1000);
+            connect(copyProgress, SIGNAL(canceled()), &copyEngine, SLOT(cancel()));
+        }
 
-        for (const QUrl &url : markedFiles) {
-            QFileInfo info(url.toLocalFile());
+        copyProgress->reset();
+        copyEngine.start(paths, targetDirUrl.toLocalFile());
+        updateCopyProgress();
+    }
+}
 
-            if (!QFile::copy(url.toLocalFile(), targetDirUrl.toLocalFile() + "/" + info.fileName())) {
-                errors++;
-            }
-        }
+void MainWindow::updateCopyProgress() {
+    if (!copyProgress || !copyEngine.isRunning())
+        return;
+
+    const qint64 total = copyEngine.getTotalBytes();
+    copyProgress->setValue(total > 0 ? copyEngine.getCopiedBytes() * 1000 / total : 0);
+    copyProgress->setLabelText("Copied " + QString::number(copyEngine.getFinishedCount()) + " of "
+                               + QString::number(copyEngine.getFileCount()) + " files\n"
+                               + QString::number(copyEngine.getCopiedBytes() / (1024 * 1024)) + " of "
+                               + QString::number(total / (1024 * 1024)) + " MB, "
+                               + QString::number(copyEngine.getMegabytesPerSecond(), 'f', 1) + " MB/s");
+}
 
-        if (errors > 0) {
-            QMessageBox msgBox;
-            msgBox.setText("Failed to copy " + QString::number(errors) + " of " + QString::number(markedFiles.size()) + " files!");
-            msgBox.exec();
+void MainWindow::copyFinished() {
+    if (copyProgress)
+        copyProgress->hide();
+
+    const int count = copyEngine.getFileCount();
+    const int copied = copyEngine.getFinishedCount() - copyEngine.getFailedCount();
+
+    //files that could not be copied stay marked
+    for (int i = 0; i < count; ++i) {
+        const CopyEngine::Result &result = copyEngine.getResult(i);
+        if (result.done && result.errorString.isEmpty())
+            imageHandler->unmarkFile(QUrl::fromLocalFile(result.path));
+    }
+    displayImageInfo();
+
+    if (copyEngine.isCancelled()) {
+        //the files that were not finished can be copied later
+        if (QMessageBox::Yes == QMessageBox::question(this, "Copying cancelled",
+                                                      "Copied " + QString::number(copied) + " of " + QString::number(count)
+                                                      + " files.\nResume copying the remaining files?")) {
+            copyProgress->reset();
+            copyEngine.resume();
+            updateCopyProgress();
+            return;
+        }
+    }
+    else if (copyEngine.getFailedCount() > 0) {
+        QString errors;
+        for (int i = 0, listed = 0; i < count && listed < 10; ++i) {
+            const CopyEngine::Result &result = copyEngine.getResult(i);
+            if (result.done && !result.errorString.isEmpty()) {
+                errors += "\n" + QFileInfo(result.path).fileName() + ": " + result.errorString;
+                listed++;
+            }
         }
 
         QMessageBox msgBox;
-        msgBox.setText("Copied " + QString::number(markedFiles.size() - errors) + " of " + QString::number(markedFiles.size()) + " files.");
+        msgBox.setText("Failed to copy " + QString::number(copyEngine.getFailedCount()) + " of " + QString::number(count) + " files!" + errors);
         msgBox.exec();
+    }
+    else {
+        ui->label_status->setText("Copied " + QString::number(copied) + " files ("
+                                  + QString::number(copyEngine.getMegabytesPerSecond(), 'f', 1) + " MB/s)");
+        statusTimer.start(5000);
+    }
 
-        imageHandler->clearMarkedFiles();
+    if (closeAfterCopy) {
+        closeAfterCopy = false;
+        close();
     }
 }
@@ -2,7 +2,12 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QTimer>
 #include "imagehandler.h"
+#include "thumbnailmodel.h"
+#include "copyengine.h"
 
 namespace Ui {
 class MainWindow;
@@ -22,12 +27,24 @@ private:
     Ui::MainWindow *ui;
     QImage currentImage;
     ImageHandler *imageHandler;
+    //thumbnail of the current image for the window icon
+    QFutureWatcher<QImage> iconWatcher;
+    ThumbnailModel *thumbnailModel;
+    bool filmstripVisible;
+    //clears the result of a save after a few seconds
+    QTimer statusTimer;
+    //copies the marked images, the window stays usable meanwhile
+    CopyEngine copyEngine;
+    QProgressDialog *copyProgress;
+    bool closeAfterCopy;
     
     void writePositionSettings();
     void readPositionSettings();
     
 private slots:
     void initImageLoaded();
+    void iconLoaded();
+    void imageSaved(QString path, QString errorString);
     void displayImageInfo();
     void openFolder();
     void convertImages();
@@ -38,6 +55,12 @@ private slots:
     void handleMultipleDropped(QList<QUrl> urls);
     void toggleMarkCurrentImage();
     void copyMarkedImages();
+    void updateCopyProgress();
+    void copyFinished();
+    void goToImage();
+    void toggleFilmstrip();
+    void toggleGrid();
+    void thumbnailSelected(int index);
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,172 @@
+#include "orientationwriter.h"
+#include "exifparser.h"
+#include "imageorientation.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QUrl>
+
+#include <string.h>
+
+OrientationWriter::OrientationWriter(QString path) :
+    path(path)
+{
+    orientation = 1;
+}
+
+//changes the orientation so the image is shown rotated by 90 degrees
+//clockwise. Returns false if the file was not changed.
+bool OrientationWriter::rotateClockwise() {
+    if(!supportsFile(path)) {
+        errorString = "Only JPEG files can be rotated without saving them again";
+        return false;
+    }
+
+    qint64 offset = -1;
+    bool littleEndian = false;
+    bool hasExifData = false;
+    {
+        //the parser keeps the file open, it is closed before writing
+        ExifParser parser(QUrl::fromLocalFile(path));
+        hasExifData = parser.isValidExifData();
+        if(hasExifData) {
+            orientation = ImageOrientation::compose(parser.getOrientation(), 6);
+            offset = parser.getShortOffset(ExifParser::IFD0, ExifParser::ORIENTATION);
+            littleEndian = parser.getFormat() == ExifParser::INTEL;
+        }
+        else {
+            orientation = 6;
+        }
+    }
+
+    if(offset >= 0)
+        return writeInPlace(offset, littleEndian);
+
+    //adding a tag to existing EXIF data would move all the offsets in it
+    if(hasExifData) {
+        errorString = "The EXIF data has no orientation tag";
+        return false;
+    }
+
+    return insertExifSegment();
+}
+
+unsigned short OrientationWriter::getOrientation() const {
+    return orientation;
+}
+
+QString OrientationWriter::getErrorString() const {
+    return errorString;
+}
+
+bool OrientationWriter::supportsFile(QString path) {
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "jpg" || suffix == "jpeg" || suffix == "jpe";
+}
+
+//overwrites the value of the existing tag, the file keeps its size
+bool OrientationWriter::writeInPlace(qint64 offset, bool littleEndian) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadWrite)) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    char value[2];
+    value[littleEndian ? 0 : 1] = (char)orientation;
+    value[littleEndian ? 1 : 0] = 0;
+    if(!file.seek(offset) || file.write(value, 2) != 2) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+//rewrites the file with an APP1 segment after the start of image marker
+//(or after the JFIF segment, which has to come first)
+bool OrientationWriter::insertExifSegment() {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    uchar header[4];
+    if(file.read(reinterpret_cast<char*>(header), 4) != 4 || header[0] != 0xFF || header[1] != 0xD8) {
+        errorString = "Not a JPEG file";
+        return false;
+    }
+
+    //the parser didn't find EXIF data, but a broken APP1 segment is not replaced
+    qint64 insertAt = 2;
+    qint64 pos = 2;
+    forever {
+        if(!file.seek(pos) || file.read(reinterpret_cast<char*>(header), 4) != 4 || header[0] != 0xFF) {
+            errorString = "Broken JPEG file";
+            return false;
+        }
+
+        if(header[1] == 0xDA || header[1] == 0xD9)
+            break;
+
+        const int segmentLength = (header[2] << 8) | header[3];
+        if(segmentLength < 2) {
+            errorString = "Broken JPEG file";
+            return false;
+        }
+
+        if(header[1] == 0xE1) {
+            char code[4];
+            if(file.read(code, 4) == 4 && memcmp(code, "Exif", 4) == 0) {
+                errorString = "Broken EXIF data";
+                return false;
+            }
+        }
+
+        if(header[1] == 0xE0 && pos == 2)
+            insertAt = pos + 2 + segmentLength;
+
+        pos += 2 + segmentLength;
+    }
+
+    //"Exif", TIFF header, IFD0 with only the orientation, no next directory
+    const uchar segment[] = {
+        0xFF, 0xE1, 0x00, 0x22,
+        'E', 'x', 'i', 'f', 0x00, 0x00,
+        'M', 'M', 0x00, 0x2A, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x01,
+        0x01, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, (uchar)orientation, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+
+    QSaveFile output(path);
+    if(!output.open(QIODevice::WriteOnly)) {
+        errorString = output.errorString();
+        return false;
+    }
+
+    file.seek(0);
+    output.write(file.read(insertAt));
+    output.write(reinterpret_cast<const char*>(segment), sizeof(segment));
+
+    //the compressed image data is copied as it is
+    while(!file.atEnd()) {
+        const QByteArray block = file.read(1024 * 1024);
+        if(block.isEmpty() || output.write(block) != block.size()) {
+            output.cancelWriting();
+            errorString = block.isEmpty() ? file.errorString() : output.errorString();
+            return false;
+        }
+    }
+
+    //the original can't be replaced while it is open on some systems
+    file.close();
+    if(!output.commit()) {
+        errorString = output.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef ORIENTATIONWRITER_H
+#define ORIENTATIONWRITER_H
+
+#include <QString>
+
+//rotates JPEG files without decoding them, only the EXIF orientation tag
+//is changed. The 2 bytes of an existing tag are overwritten in place. Files
+//without EXIF data get a minimal APP1 segment with just the orientation, the
+//rest of the file is copied unchanged. The pixels and all other metadata stay
+//exactly as they are, the decoder applies the new orientation when the file
+//is loaded.
+class OrientationWriter
+{
+public:
+    OrientationWriter(QString path);
+    bool rotateClockwise();
+    unsigned short getOrientation() const;
+    QString getErrorString() const;
+
+    static bool supportsFile(QString path);
+
+private:
+    QString path;
+    unsigned short orientation;
+    QString errorString;
+
+    bool writeInPlace(qint64 offset, bool littleEndian);
+    bool insertExifSegment();
+};
+
+#endif // ORIENTATIONWRITER_H
@@ -0,0 +1,626 @@
+#include "paralleldecoder.h"
+#include "tiffreader.h"
+
+#include <QAtomicInt>
+#include <QBuffer>
+#include <QColorSpace>
+#include <QDataStream>
+#include <QImageReader>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <string.h>
+
+namespace {
+
+//shared by the workers that decode the segments
+struct DecodeContext {
+    QImage::Format format;
+    //destination, bits() must not be called on the worker threads
+    uchar *bits;
+    qptrdiff bytesPerLine;
+    int pixelBytes;
+    QAtomicInt failed;
+    //set when the image is not needed anymore, may be null
+    const QAtomicInt *cancelled;
+};
+
+struct DecodeTask {
+    DecodeContext *context;
+    const ParallelDecoder::Segment *segment;
+};
+
+struct TiffEntry {
+    quint16 tag;
+    quint16 type;
+    QVector<quint32> values;
+};
+
+}
+
+static QImage decodeSegment(const ParallelDecoder::Segment &segment) {
+    QBuffer buffer;
+    buffer.setData(segment.data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer, segment.format);
+    //the size of the whole image has been checked against the limit already
+    reader.setAllocationLimit(0);
+    //the orientation is applied to the whole image by ImageDecoder
+    reader.setAutoTransform(false);
+
+    return reader.read();
+}
+
+//copies a decoded segment to its rows of the image, fails if it doesn't cover them
+static bool copySegment(const QImage &part, const QRect &rect, int skipRows, DecodeContext *context) {
+    if(part.isNull() || part.format() != context->format
+            || part.width() < rect.width() || part.height() < skipRows + rect.height())
+        return false;
+
+    const qptrdiff rowBytes = (qptrdiff)rect.width() * context->pixelBytes;
+    for(int y = 0; y < rect.height(); ++y) {
+        uchar *dst = context->bits + (rect.top() + y) * context->bytesPerLine + rect.left() * context->pixelBytes;
+        memcpy(dst, part.constScanLine(skipRows + y), rowBytes);
+    }
+
+    return true;
+}
+
+//runs on the worker threads
+static void decodeTask(DecodeTask &task) {
+    DecodeContext *context = task.context;
+    if(context->failed.loadRelaxed() || (context->cancelled && context->cancelled->loadRelaxed()))
+        return;
+
+    QImage part = decodeSegment(*task.segment);
+    if(!part.isNull() && part.format() != context->format)
+        part = part.convertToFormat(context->format);
+
+    if(!copySegment(part, task.segment->rect, task.segment->skipRows, context))
+        context->failed.storeRelaxed(1);
+}
+
+static qint64 greatestCommonDivisor(qint64 a, qint64 b) {
+    while(b != 0) {
+        const qint64 rest = a % b;
+        a = b;
+        b = rest;
+    }
+
+    return a;
+}
+
+ParallelDecoder::ParallelDecoder(QString path) :
+    file(path)
+{
+    data = 0;
+    length = 0;
+}
+
+//returns a null image if the file can't be split, see getErrorString()
+QImage ParallelDecoder::read() {
+    return decode(QRect());
+}
+
+//decodes the part rect of a TIFF, which has to start at the corner of a
+//strip or tile (see TiffReader::getBlockSize()). Returns a null image for
+//other files, see getErrorString().
+QImage ParallelDecoder::readRegion(QRect rect) {
+    if(rect.isEmpty()) {
+        errorString = "Empty region";
+        return QImage();
+    }
+
+    return decode(rect);
+}
+
+//the whole image if rect is null
+QImage ParallelDecoder::decode(QRect rect) {
+    if(!file.open(QIODevice::ReadOnly)) {
+        errorString = file.errorString();
+        return QImage();
+    }
+
+    length = file.size();
+    data = file.map(0, length);
+    if(!data) {
+        buffer = file.readAll();
+        data = reinterpret_cast<const uchar*>(buffer.constData());
+        length = buffer.size();
+    }
+
+    //a few segments per thread, so threads that finish early take over the rest
+    const int count = QThreadPool::globalInstance()->maxThreadCount() * 2;
+
+    bool split = false;
+    if(length >= 4 && data[0] == 0xFF && data[1] == 0xD8 && rect.isNull())
+        split = splitJpeg(count);
+    else if(length >= 4 && (memcmp(data, "II*\0", 4) == 0 || memcmp(data, "MM\0*", 4) == 0))
+        split = splitTiff(count, rect);
+
+    //a region is worth it even if it is a single segment
+    if(!split || segments.size() < (rect.isNull() ? 2 : 1)) {
+        if(errorString.isEmpty())
+            errorString = "Image can't be split";
+        return QImage();
+    }
+
+    //the first segment is decoded here, it decides the format of the image
+    QImage first = decodeSegment(segments.first());
+    if(first.isNull()) {
+        errorString = "Corrupt image data";
+        return QImage();
+    }
+
+    QImage image(imageSize, first.format());
+    if(image.isNull()) {
+        errorString = "Not enough memory";
+        return QImage();
+    }
+
+    image.setColorTable(first.colorTable());
+    if(first.colorSpace().isValid() || iccProfile.isEmpty())
+        image.setColorSpace(first.colorSpace());
+    else
+        image.setColorSpace(QColorSpace::fromIccProfile(iccProfile));
+
+    DecodeContext context;
+    context.format = image.format();
+    context.bits = image.bits();
+    context.bytesPerLine = image.bytesPerLine();
+    context.pixelBytes = image.depth() / 8;
+    context.cancelled = cancelFlag.data();
+
+    if(image.depth() % 8 != 0 || !copySegment(first, segments.first().rect, segments.first().skipRows, &context)) {
+        errorString = "Unsupported pixel format";
+        return QImage();
+    }
+
+    QList<DecodeTask> tasks;
+    for(int i = 1; i < segments.size(); ++i) {
+        DecodeTask task;
+        task.context = &context;
+        task.segment = &segments.at(i);
+        tasks.append(task);
+    }
+
+    QtConcurrent::blockingMap(tasks, decodeTask);
+
+    if(cancelFlag && cancelFlag->loadRelaxed()) {
+        errorString = "Cancelled";
+        return QImage();
+    }
+
+    if(context.failed.loadRelaxed()) {
+        errorString = "Corrupt image data";
+        return QImage();
+    }
+
+    return image;
+}
+
+//segments that haven't started yet are skipped once the flag is set, read() then fails
+void ParallelDecoder::setCancelFlag(QSharedPointer<QAtomicInt> flag) {
+    cancelFlag = flag;
+}
+
+QString ParallelDecoder::getErrorString() const {
+    return errorString;
+}
+
+//how many parts the image was split into by read()
+int ParallelDecoder::getSegmentCount() const {
+    return segments.size();
+}
+
+//splits a baseline JPEG into segments of whole rows of MCUs. The DC
+//prediction restarts at every restart marker, so the data of a group of
+//restart intervals can be decoded on its own with the tables of the file.
+bool ParallelDecoder::splitJpeg(int count) {
+    //everything the decoder needs up to the start of the scan, without EXIF data
+    QByteArray header("\xFF\xD8", 2);
+    int heightIndex = -1;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    int maxHorizontal = 1;
+    int maxVertical = 1;
+    int restartInterval = 0;
+    qint64 scanStart = -1;
+    qint64 pos = 2;
+
+    while(pos + 4 <= length) {
+        if(data[pos] != 0xFF)
+            return false;
+
+        const uchar marker = data[pos + 1];
+        if(marker == 0xFF) {
+            //fill byte
+            ++pos;
+            continue;
+        }
+
+        const int segmentLength = readUnsignedShort(data + pos + 2);
+        if(segmentLength < 2 || pos + 2 + segmentLength > length)
+            return false;
+
+        const uchar *payload = data + pos + 4;
+        const int payloadLength = segmentLength - 2;
+
+        if(marker == 0xC0 || marker == 0xC1) {
+            //precision (1 byte), height (2 bytes), width (2 bytes), components (1 byte),
+            //id, sampling factors and quantization table (1 byte each) per component
+            if(payloadLength < 6)
+                return false;
+
+            height = readUnsignedShort(payload + 1);
+            width = readUnsignedShort(payload + 3);
+            components = payload[5];
+            if(components == 0 || payloadLength < 6 + components * 3)
+                return false;
+
+            for(int i = 0; i < components; ++i) {
+                maxHorizontal = qMax(maxHorizontal, payload[7 + i * 3] >> 4);
+                maxVertical = qMax(maxVertical, payload[7 + i * 3] & 0x0F);
+            }
+
+            heightIndex = header.size() + 5;
+        }
+        else if(marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            errorString = "Only baseline JPEGs can be split";
+            return false;
+        }
+        else if(marker == 0xDD) {
+            if(payloadLength < 2)
+                return false;
+
+            restartInterval = readUnsignedShort(payload);
+        }
+        else if(marker == 0xDA) {
+            //the scan has to contain all components, otherwise more scans follow
+            if(payloadLength < 1 || payload[0] != components)
+                return false;
+
+            header.append(reinterpret_cast<const char*>(data + pos), segmentLength + 2);
+            scanStart = pos + 2 + segmentLength;
+            break;
+        }
+
+        //the orientation is applied by ImageDecoder, EXIF and XMP data and comments are not needed
+        if(marker != 0xE1 && marker != 0xFE)
+            header.append(reinterpret_cast<const char*>(data + pos), segmentLength + 2);
+
+        pos += 2 + segmentLength;
+    }
+
+    if(restartInterval == 0) {
+        errorString = "No restart markers";
+        return false;
+    }
+
+    if(scanStart < 0 || heightIndex < 0 || width == 0 || height == 0)
+        return false;
+
+    //interleaved scans are made of MCUs of the largest sampling factors,
+    //scans of a single component of single 8x8 blocks
+    const int mcuWidth = components == 1 ? 8 : 8 * maxHorizontal;
+    const int mcuHeight = components == 1 ? 8 : 8 * maxVertical;
+    const qint64 mcusPerRow = (width + mcuWidth - 1) / mcuWidth;
+    const qint64 mcuRows = (height + mcuHeight - 1) / mcuHeight;
+    const qint64 intervalCount = (mcusPerRow * mcuRows + restartInterval - 1) / restartInterval;
+
+    //positions of the restart markers. The scan ends at the first other marker,
+    //0xFF bytes in the entropy coded data are followed by 0x00.
+    QVector<qint64> restarts;
+    qint64 scanEnd = -1;
+    pos = scanStart;
+    while(pos + 1 < length) {
+        const uchar *next = static_cast<const uchar*>(memchr(data + pos, 0xFF, length - pos - 1));
+        if(!next)
+            break;
+
+        pos = next - data;
+        const uchar marker = data[pos + 1];
+        if(marker == 0x00) {
+            pos += 2;
+        }
+        else if(marker == 0xFF) {
+            ++pos;
+        }
+        else if(marker >= 0xD0 && marker <= 0xD7) {
+            restarts.append(pos);
+            pos += 2;
+        }
+        else {
+            scanEnd = pos;
+            break;
+        }
+    }
+
+    if(scanEnd < 0 || restarts.size() + 1 != intervalCount) {
+        errorString = "Corrupt image data";
+        return false;
+    }
+
+    //segments start at a restart marker that is also the start of a row of MCUs
+    const qint64 unitMcus = mcusPerRow / greatestCommonDivisor(mcusPerRow, restartInterval) * restartInterval;
+    const qint64 unitIntervals = unitMcus / restartInterval;
+    const qint64 unitRows = unitMcus / mcusPerRow;
+    const qint64 units = (mcuRows + unitRows - 1) / unitRows;
+    if(units < 2)
+        return false;
+
+    const qint64 unitsPerSegment = (units + count - 1) / count;
+    const qint64 unitHeight = unitRows * mcuHeight;
+    imageSize = QSize(width, height);
+
+    //vertically subsampled chroma is upsampled with the rows above and below,
+    //so the segments overlap by a unit and the rows next to the cut are dropped
+    const qint64 overlap = maxVertical > 1 ? 1 : 0;
+
+    for(qint64 firstUnit = 0; firstUnit < units; firstUnit += unitsPerSegment) {
+        const qint64 endUnit = qMin(firstUnit + unitsPerSegment, units);
+        const qint64 decodeFirstUnit = qMax<qint64>(firstUnit - overlap, 0);
+        const qint64 decodeEndUnit = qMin(endUnit + overlap, units);
+
+        const qint64 firstInterval = decodeFirstUnit * unitIntervals;
+        const qint64 endInterval = qMin(decodeEndUnit * unitIntervals, intervalCount);
+        const int decodeY = decodeFirstUnit * unitHeight;
+        const int decodeRows = qMin<qint64>(decodeEndUnit * unitHeight, height) - decodeY;
+        const int y = firstUnit * unitHeight;
+        const int rows = qMin<qint64>(endUnit * unitHeight, height) - y;
+
+        const qint64 start = firstInterval == 0 ? scanStart : restarts.at(firstInterval - 1) + 2;
+        const qint64 end = endInterval == intervalCount ? scanEnd : restarts.at(endInterval - 1);
+
+        Segment segment;
+        segment.format = "jpeg";
+        segment.rect = QRect(0, y, width, rows);
+        segment.skipRows = y - decodeY;
+        segment.data = header;
+        segment.data.reserve(header.size() + (end - start) + 2);
+        segment.data[heightIndex] = char(decodeRows >> 8);
+        segment.data[heightIndex + 1] = char(decodeRows & 0xFF);
+
+        const int entropyStart = segment.data.size();
+        segment.data.append(reinterpret_cast<const char*>(data + start), end - start);
+
+        //the decoder expects the restart markers to count from 0 again
+        for(qint64 i = firstInterval; i < endInterval - 1; ++i)
+            segment.data[entropyStart + (int)(restarts.at(i) - start) + 1] = char(0xD0 + ((i - firstInterval) & 7));
+
+        segment.data.append("\xFF\xD9", 2);
+        segments.append(segment);
+    }
+
+    return true;
+}
+
+//splits a TIFF at the boundaries of its strips or rows of tiles. Every
+//segment is a TIFF file with the compressed blocks of its rows. If rect
+//isn't null, only the blocks intersecting it are used.
+bool ParallelDecoder::splitTiff(int count, QRect rect) {
+    TiffReader tiff(file.fileName());
+    if(!tiff.isValid())
+        return false;
+
+    //JPEG compressed blocks share their tables, they are left to Qt's plugin
+    const quint32 compression = tiff.getValues(TiffReader::COMPRESSION).value(0, 1);
+    if(compression != 1 && compression != 5 && compression != 8 && compression != 32773 && compression != 32946) {
+        errorString = "Unsupported compression";
+        return false;
+    }
+
+    //gray and RGB images with 8 or 16 bit integer samples
+    if(tiff.getValues(TiffReader::PHOTOMETRIC).value(0, 0) > 2
+            || tiff.getValues(TiffReader::PLANAR_CONFIGURATION).value(0, 1) != 1
+            || tiff.getValues(TiffReader::SAMPLE_FORMAT).value(0, 1) != 1
+            || tiff.getValues(TiffReader::FILL_ORDER).value(0, 1) != 1)
+        return false;
+
+    const QVector<quint32> bits = tiff.getValues(TiffReader::BITS_PER_SAMPLE);
+    if(bits.isEmpty())
+        return false;
+
+    for(quint32 bitsPerSample : bits) {
+        if(bitsPerSample != bits.first() || (bitsPerSample != 8 && bitsPerSample != 16))
+            return false;
+    }
+
+    const bool tiled = tiff.hasTag(TiffReader::TILE_WIDTH);
+    const QSize size = tiff.getSize();
+    const QSize blockSize = tiff.getBlockSize();
+    if(blockSize.isEmpty())
+        return false;
+
+    const QVector<quint32> offsets = tiff.getValues(tiled ? TiffReader::TILE_OFFSETS : TiffReader::STRIP_OFFSETS);
+    const QVector<quint32> byteCounts = tiff.getValues(tiled ? TiffReader::TILE_BYTE_COUNTS : TiffReader::STRIP_BYTE_COUNTS);
+    const int across = tiled ? (size.width() + blockSize.width() - 1) / blockSize.width() : 1;
+    const int down = (size.height() + blockSize.height() - 1) / blockSize.height();
+    if(offsets.size() != across * down || byteCounts.size() != offsets.size())
+        return false;
+
+    //columns and rows of blocks to decode
+    QRect blocks(0, 0, across, down);
+    if(rect.isNull()) {
+        if(down < 2)
+            return false;
+
+        rect = QRect(QPoint(0, 0), size);
+    }
+    else {
+        if(rect.left() % blockSize.width() != 0 || rect.top() % blockSize.height() != 0)
+            return false;
+
+        rect &= QRect(QPoint(0, 0), size);
+        if(rect.isEmpty())
+            return false;
+
+        blocks = QRect(QPoint(rect.left() / blockSize.width(), rect.top() / blockSize.height()),
+                       QPoint(rect.right() / blockSize.width(), rect.bottom() / blockSize.height()));
+    }
+
+    for(int i = 0; i < offsets.size(); ++i) {
+        if((qint64)offsets.at(i) + byteCounts.at(i) > length)
+            return false;
+    }
+
+    const QVector<quint32> profile = tiff.getValues(TiffReader::ICC_PROFILE);
+    iccProfile.resize(profile.size());
+    for(int i = 0; i < profile.size(); ++i)
+        iccProfile[i] = char(profile.at(i));
+
+    imageSize = rect.size();
+    const int rowsPerSegment = (blocks.height() + count - 1) / count;
+
+    for(int firstRow = blocks.top(); firstRow <= blocks.bottom(); firstRow += rowsPerSegment) {
+        const int endRow = qMin(firstRow + rowsPerSegment, blocks.bottom() + 1);
+        const int y = firstRow * blockSize.height();
+        const int rows = qMin(endRow * blockSize.height(), size.height()) - y;
+
+        //tiles are always complete, the last strip may be shorter
+        const QSize segmentSize = tiled ? QSize(blocks.width() * blockSize.width(), (endRow - firstRow) * blockSize.height())
+                                        : QSize(size.width(), rows);
+
+        QVector<int> segmentBlocks;
+        for(int row = firstRow; row < endRow; ++row) {
+            for(int column = blocks.left(); column <= blocks.right(); ++column)
+                segmentBlocks.append(row * across + column);
+        }
+
+        //the decoded blocks start at the corner of rect and may reach beyond it
+        Segment segment;
+        segment.format = "tiff";
+        segment.rect = QRect(0, y - rect.top(), rect.width(), qMin(y + rows, rect.bottom() + 1) - y);
+        segment.skipRows = 0;
+        segment.data = writeTiff(tiff, segmentSize, segmentBlocks);
+        segments.append(segment);
+    }
+
+    return true;
+}
+
+//a TIFF file with the given blocks of the image, in rows of size. The
+//blocks keep their compression and byte order.
+QByteArray ParallelDecoder::writeTiff(const TiffReader &tiff, QSize size, const QVector<int> &blocks) const {
+    const quint16 SHORT = 3;
+    const quint16 LONG = 4;
+    const bool tiled = tiff.hasTag(TiffReader::TILE_WIDTH);
+    const QSize blockSize = tiff.getBlockSize();
+    const QVector<quint32> offsets = tiff.getValues(tiled ? TiffReader::TILE_OFFSETS : TiffReader::STRIP_OFFSETS);
+    const QVector<quint32> allByteCounts = tiff.getValues(tiled ? TiffReader::TILE_BYTE_COUNTS : TiffReader::STRIP_BYTE_COUNTS);
+
+    QVector<quint32> byteCounts;
+    byteCounts.reserve(blocks.size());
+    for(int block : blocks)
+        byteCounts.append(allByteCounts.at(block));
+
+    //entries have to be sorted by their tag
+    QList<TiffEntry> entries;
+    entries.append({ TiffReader::IMAGE_WIDTH, LONG, QVector<quint32>() << size.width() });
+    entries.append({ TiffReader::IMAGE_LENGTH, LONG, QVector<quint32>() << size.height() });
+    entries.append({ TiffReader::BITS_PER_SAMPLE, SHORT, tiff.getValues(TiffReader::BITS_PER_SAMPLE) });
+    entries.append({ TiffReader::COMPRESSION, SHORT, tiff.getValues(TiffReader::COMPRESSION) });
+    entries.append({ TiffReader::PHOTOMETRIC, SHORT, tiff.getValues(TiffReader::PHOTOMETRIC) });
+    if(!tiled)
+        entries.append({ TiffReader::STRIP_OFFSETS, LONG, QVector<quint32>(byteCounts.size()) });
+    entries.append({ TiffReader::SAMPLES_PER_PIXEL, SHORT, QVector<quint32>() << tiff.getValues(TiffReader::SAMPLES_PER_PIXEL).value(0, 1) });
+    if(!tiled) {
+        entries.append({ TiffReader::ROWS_PER_STRIP, LONG, QVector<quint32>() << blockSize.height() });
+        entries.append({ TiffReader::STRIP_BYTE_COUNTS, LONG, byteCounts });
+    }
+    entries.append({ TiffReader::PLANAR_CONFIGURATION, SHORT, QVector<quint32>() << 1 });
+    if(tiff.hasTag(TiffReader::PREDICTOR))
+        entries.append({ TiffReader::PREDICTOR, SHORT, tiff.getValues(TiffReader::PREDICTOR) });
+    if(tiled) {
+        entries.append({ TiffReader::TILE_WIDTH, LONG, QVector<quint32>() << blockSize.width() });
+        entries.append({ TiffReader::TILE_LENGTH, LONG, QVector<quint32>() << blockSize.height() });
+        entries.append({ TiffReader::TILE_OFFSETS, LONG, QVector<quint32>(byteCounts.size()) });
+        entries.append({ TiffReader::TILE_BYTE_COUNTS, LONG, byteCounts });
+    }
+    if(tiff.hasTag(TiffReader::EXTRA_SAMPLES))
+        entries.append({ TiffReader::EXTRA_SAMPLES, SHORT, tiff.getValues(TiffReader::EXTRA_SAMPLES) });
+
+    //header (8 bytes), directory, values that don't fit into the entries, blocks
+    const quint32 directoryEnd = 8 + 2 + entries.size() * 12 + 4;
+    quint32 externalSize = 0;
+    for(const TiffEntry &entry : entries) {
+        const quint32 bytes = entry.values.size() * (entry.type == SHORT ? 2 : 4);
+        if(bytes > 4)
+            externalSize += bytes;
+    }
+
+    qint64 blocksSize = 0;
+    for(quint32 byteCount : byteCounts)
+        blocksSize += byteCount;
+
+    for(TiffEntry &entry : entries) {
+        if(entry.tag == TiffReader::STRIP_OFFSETS || entry.tag == TiffReader::TILE_OFFSETS) {
+            quint32 offset = directoryEnd + externalSize;
+            for(int i = 0; i < byteCounts.size(); ++i) {
+                entry.values[i] = offset;
+                offset += byteCounts.at(i);
+            }
+        }
+    }
+
+    QByteArray result;
+    result.reserve(directoryEnd + externalSize + blocksSize);
+    QBuffer buffer(&result);
+    buffer.open(QIODevice::WriteOnly);
+
+    QDataStream stream(&buffer);
+    stream.setByteOrder(tiff.isBigEndian() ? QDataStream::BigEndian : QDataStream::LittleEndian);
+    stream.writeRawData(tiff.isBigEndian() ? "MM" : "II", 2);
+    stream << quint16(42) << quint32(8) << quint16(entries.size());
+
+    //values that fit into 4 bytes are stored in the entry itself, left aligned
+    quint32 external = directoryEnd;
+    for(const TiffEntry &entry : entries) {
+        stream << entry.tag << entry.type << quint32(entry.values.size());
+
+        const int valueSize = entry.type == SHORT ? 2 : 4;
+        const int bytes = entry.values.size() * valueSize;
+        if(bytes > 4) {
+            stream << external;
+            external += bytes;
+            continue;
+        }
+
+        for(quint32 value : entry.values) {
+            if(entry.type == SHORT)
+                stream << quint16(value);
+            else
+                stream << value;
+        }
+
+        for(int i = bytes; i < 4; ++i)
+            stream << quint8(0);
+    }
+
+    //no further directories
+    stream << quint32(0);
+
+    for(const TiffEntry &entry : entries) {
+        if(entry.values.size() * (entry.type == SHORT ? 2 : 4) <= 4)
+            continue;
+
+        for(quint32 value : entry.values) {
+            if(entry.type == SHORT)
+                stream << quint16(value);
+            else
+                stream << value;
+        }
+    }
+
+    for(int i = 0; i < blocks.size(); ++i)
+        stream.writeRawData(reinterpret_cast<const char*>(data + offsets.at(blocks.at(i))), byteCounts.at(i));
+
+    return result;
+}
+
+quint16 ParallelDecoder::readUnsignedShort(const uchar *data) {
+    return (data[0] << 8) | data[1];
+}
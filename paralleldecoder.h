@@ -0,0 +1,70 @@
+#ifndef PARALLELDECODER_H
+#define PARALLELDECODER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+class TiffReader;
+
+// https://www.w3.org/Graphics/JPEG/itu-t81.pdf
+// https://www.adobe.io/content/dam/udp/en/open/standards/tiff/TIFF6.pdf
+
+//decodes a single large image on all cores. The image is split into parts
+//that can be decoded independently, every part is wrapped into a small file
+//of its own and decoded by Qt's plugin on a worker thread, straight into
+//the rows of the result.
+//JPEGs are split at restart markers (baseline JPEGs with a restart interval
+//only), TIFFs at the boundaries of their strips or rows of tiles.
+//read() returns a null image for every other file, it is then decoded
+//the usual way. readRegion() decodes only the strips or tiles of a TIFF
+//that intersect the region, whatever their compression.
+class ParallelDecoder
+{
+public:
+    ParallelDecoder(QString path);
+    QImage read();
+    QImage readRegion(QRect rect);
+    void setCancelFlag(QSharedPointer<QAtomicInt> flag);
+    QString getErrorString() const;
+    int getSegmentCount() const;
+
+    //a part of the image, as a file of its own
+    struct Segment {
+        QByteArray data;
+        QByteArray format;
+        //the part of the image it covers, the decoded segment may be padded
+        QRect rect;
+        //rows at the top of the decoded segment that belong to the segment above
+        int skipRows;
+    };
+
+private:
+    QFile file;
+    QString errorString;
+    QList<Segment> segments;
+    QSize imageSize;
+    const uchar *data;
+    qint64 length;
+    //only used if the file can't be mapped
+    QByteArray buffer;
+    //the JPEG plugin finds the profile in the segments, the TIFF plugin doesn't
+    QByteArray iccProfile;
+    QSharedPointer<QAtomicInt> cancelFlag;
+
+    QImage decode(QRect rect);
+    bool splitJpeg(int count);
+    bool splitTiff(int count, QRect rect);
+    QByteArray writeTiff(const TiffReader &tiff, QSize size, const QVector<int> &blocks) const;
+
+    static quint16 readUnsignedShort(const uchar *data);
+};
+
+#endif // PARALLELDECODER_H
@@ -0,0 +1,465 @@
+#include "psdreader.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QAtomicInt>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <string.h>
+
+namespace {
+
+//shared by the workers that decode the rows of the merged image
+struct PsdContext {
+    QString path;
+    const QVector<qint64> *offsets;
+    const QVector<quint32> *lengths;
+    bool compressed;
+    int height;
+    int bytesPerSample;
+    //part of the image that is read, every step-th row and column of it
+    QRect rect;
+    int step;
+    //destination, bits() must not be called on the worker threads
+    uchar *bits;
+    qptrdiff bytesPerLine;
+    int pixelBytes;
+    int outputWidth;
+    QAtomicInt failed;
+};
+
+//rows [firstRow, lastRow) of the destination of one channel
+struct PsdBlock {
+    PsdContext *context;
+    int channel;
+    //byte of the destination pixel the channel is written to
+    int target;
+    int firstRow;
+    int lastRow;
+};
+
+}
+
+//PackBits, stops as soon as the row has dstLength bytes
+static bool unpackBits(const uchar *src, int srcLength, uchar *dst, int dstLength) {
+    int in = 0;
+    int out = 0;
+
+    while(out < dstLength && in < srcLength) {
+        const int n = (signed char)src[in++];
+
+        if(n >= 0) {
+            //n + 1 literal bytes
+            const int count = qMin(n + 1, dstLength - out);
+            if(in + count > srcLength)
+                return false;
+
+            memcpy(dst + out, src + in, count);
+            in += n + 1;
+            out += count;
+        }
+        else if(n != -128) {
+            //the next byte repeated 1 - n times
+            const int count = qMin(1 - n, dstLength - out);
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+
+    return out == dstLength;
+}
+
+//runs on the worker threads
+static void decodeBlock(PsdBlock &block) {
+    PsdContext *context = block.context;
+
+    QFile file(context->path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        context->failed.storeRelaxed(1);
+        return;
+    }
+
+    //the row is only needed up to the right edge of the rect
+    const int rowBytes = (context->rect.right() + 1) * context->bytesPerSample;
+    QByteArray row(rowBytes, 0);
+    QByteArray packed;
+
+    for(int outY = block.firstRow; outY < block.lastRow; ++outY) {
+        if(context->failed.loadRelaxed())
+            return;
+
+        const int y = context->rect.top() + outY * context->step;
+        const int index = block.channel * context->height + y;
+
+        if(!file.seek(context->offsets->at(index))) {
+            context->failed.storeRelaxed(1);
+            return;
+        }
+
+        bool ok;
+        if(context->compressed) {
+            packed.resize(context->lengths->at(index));
+            ok = file.read(packed.data(), packed.size()) == packed.size()
+                    && unpackBits(reinterpret_cast<const uchar*>(packed.constData()), packed.size(),
+                                  reinterpret_cast<uchar*>(row.data()), rowBytes);
+        }
+        else {
+            ok = file.read(row.data(), rowBytes) == rowBytes;
+        }
+
+        if(!ok) {
+            context->failed.storeRelaxed(1);
+            return;
+        }
+
+        //samples are big endian, the first byte of 16 bit samples is the one that matters
+        const uchar *src = reinterpret_cast<const uchar*>(row.constData()) + context->rect.left() * context->bytesPerSample;
+        const int srcStep = context->step * context->bytesPerSample;
+        uchar *dst = context->bits + outY * context->bytesPerLine + block.target;
+
+        for(int x = 0; x < context->outputWidth; ++x) {
+            *dst = *src;
+            src += srcStep;
+            dst += context->pixelBytes;
+        }
+    }
+}
+
+PsdReader::PsdReader(QString path) {
+    this->path = path;
+    bigDocument = false;
+    channels = 0;
+    width = 0;
+    height = 0;
+    depth = 0;
+    colorMode = 0;
+    resourcesOffset = 0;
+    resourcesLength = 0;
+    imageDataOffset = 0;
+
+    valid = readHeader();
+}
+
+bool PsdReader::isValid() const {
+    return valid;
+}
+
+QSize PsdReader::getSize() const {
+    return QSize(width, height);
+}
+
+QString PsdReader::getErrorString() const {
+    return errorString;
+}
+
+//the JPEG thumbnail Photoshop stores in the image resources, null if there is none
+QImage PsdReader::readThumbnail() {
+    if(!valid)
+        return QImage();
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return QImage();
+
+    QDataStream stream(&file);
+    const qint64 end = resourcesOffset + resourcesLength;
+    qint64 pos = resourcesOffset;
+
+    //signature (4 bytes), id (2 bytes), padded pascal string name, size (4 bytes), padded data
+    while(pos + 12 <= end && file.seek(pos)) {
+        char signature[4];
+        quint16 id;
+        quint8 nameLength;
+        if(stream.readRawData(signature, 4) != 4)
+            return QImage();
+
+        stream >> id >> nameLength;
+
+        const qint64 sizePos = pos + 6 + ((nameLength + 2) & ~1);
+        quint32 size;
+        if(!file.seek(sizePos))
+            return QImage();
+
+        stream >> size;
+        if(stream.status() != QDataStream::Ok)
+            return QImage();
+
+        const qint64 dataPos = sizePos + 4;
+
+        //format (4 bytes, 1 = JPEG) and 24 bytes of sizes in front of the JPEG
+        if(id == 1036 && size > 28 && dataPos + size <= end) {
+            QByteArray data = file.read(size);
+            if(data.size() != (int)size || data.at(3) != 1)
+                return QImage();
+
+            return QImage::fromData(reinterpret_cast<const uchar*>(data.constData()) + 28, size - 28, "JPG");
+        }
+
+        pos = dataPos + ((size + 1) & ~1);
+    }
+
+    return QImage();
+}
+
+//reads rect of the merged image (the whole image if it is null), scaled to
+//scaledSize. Rows and columns are skipped as long as the image stays larger
+//than scaledSize, the rest is smoothly scaled.
+QImage PsdReader::read(QRect rect, QSize scaledSize) {
+    if(!valid)
+        return QImage();
+
+    const QRect bounds(0, 0, width, height);
+    rect = rect.isNull() ? bounds : (rect & bounds);
+    if(rect.isEmpty()) {
+        errorString = "Region outside of the image";
+        return QImage();
+    }
+
+    if(!scaledSize.isValid() || scaledSize.isEmpty())
+        scaledSize = rect.size();
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly) || !file.seek(imageDataOffset)) {
+        errorString = file.errorString();
+        return QImage();
+    }
+
+    quint16 compression;
+    QDataStream(&file) >> compression;
+
+    //only raw and RLE data is supported, ZIP is left to Qt's plugin
+    if(compression != 0 && compression != 1) {
+        errorString = "Unsupported compression";
+        return QImage();
+    }
+
+    QVector<qint64> offsets;
+    QVector<quint32> lengths;
+    if(!readRowOffsets(compression, offsets, lengths)) {
+        errorString = "Corrupt image data";
+        return QImage();
+    }
+
+    const int step = qMax(1, qMin(rect.width() / scaledSize.width(), rect.height() / scaledSize.height()));
+    const QSize outputSize((rect.width() + step - 1) / step, (rect.height() + step - 1) / step);
+
+    //which channels are decoded and where they go in the destination pixel
+    QImage::Format format = QImage::Format_RGBX8888;
+    QList<int> targets;
+    if(colorMode == GRAYSCALE) {
+        format = QImage::Format_Grayscale8;
+        targets << 0;
+    }
+    else if(colorMode == RGB) {
+        //further channels are saved selections or spot colors
+        targets << 0 << 1 << 2;
+    }
+    else {
+        targets << 0 << 1 << 2 << 3;
+    }
+
+    QImage image(outputSize, format);
+    if(image.isNull()) {
+        errorString = "Not enough memory";
+        return QImage();
+    }
+
+    image.fill(0xFFFFFFFF);
+
+    PsdContext context;
+    context.path = path;
+    context.offsets = &offsets;
+    context.lengths = &lengths;
+    context.compressed = compression == 1;
+    context.height = height;
+    context.bytesPerSample = depth / 8;
+    context.rect = rect;
+    context.step = step;
+    context.bits = image.bits();
+    context.bytesPerLine = image.bytesPerLine();
+    context.pixelBytes = image.depth() / 8;
+    context.outputWidth = outputSize.width();
+
+    //blocks of rows of every channel are decoded in parallel
+    const int blockRows = 64;
+    QList<PsdBlock> blocks;
+    for(int channel = 0; channel < targets.size(); ++channel) {
+        for(int row = 0; row < outputSize.height(); row += blockRows) {
+            PsdBlock block;
+            block.context = &context;
+            block.channel = channel;
+            block.target = targets.at(channel);
+            block.firstRow = row;
+            block.lastRow = qMin(row + blockRows, outputSize.height());
+            blocks.append(block);
+        }
+    }
+
+    QtConcurrent::blockingMap(blocks, decodeBlock);
+
+    if(context.failed.loadRelaxed()) {
+        errorString = "Corrupt image data";
+        return QImage();
+    }
+
+    //CMYK is stored inverted, 255 means no ink
+    if(colorMode == CMYK) {
+        for(int y = 0; y < image.height(); ++y) {
+            uchar *pixel = image.scanLine(y);
+            for(int x = 0; x < image.width(); ++x, pixel += 4) {
+                const int k = pixel[3];
+                pixel[0] = pixel[0] * k / 255;
+                pixel[1] = pixel[1] * k / 255;
+                pixel[2] = pixel[2] * k / 255;
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    if(image.size() != scaledSize)
+        image = image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    return image;
+}
+
+bool PsdReader::isPsdFile(QString path) {
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "psd" || suffix == "psb";
+}
+
+//reads the file header and the lengths of the sections in front of the merged image
+bool PsdReader::readHeader() {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    //PSD files are big endian, which is the default of QDataStream
+    QDataStream stream(&file);
+
+    char signature[4];
+    quint16 version;
+    if(stream.readRawData(signature, 4) != 4 || memcmp(signature, "8BPS", 4) != 0) {
+        errorString = "Not a PSD file";
+        return false;
+    }
+
+    stream >> version;
+    stream.skipRawData(6);
+
+    quint16 channelCount;
+    quint32 rows;
+    quint32 columns;
+    quint16 bitsPerChannel;
+    quint16 mode;
+    stream >> channelCount >> rows >> columns >> bitsPerChannel >> mode;
+
+    //color mode data section
+    quint32 colorDataLength;
+    stream >> colorDataLength;
+
+    if(stream.status() != QDataStream::Ok || (version != 1 && version != 2)) {
+        errorString = "Corrupt PSD header";
+        return false;
+    }
+
+    bigDocument = version == 2;
+    channels = channelCount;
+    width = columns;
+    height = rows;
+    depth = bitsPerChannel;
+    colorMode = mode;
+
+    const int neededChannels = colorMode == GRAYSCALE ? 1 : (colorMode == RGB ? 3 : 4);
+    if((colorMode != GRAYSCALE && colorMode != RGB && colorMode != CMYK) || (depth != 8 && depth != 16)
+            || channels < neededChannels || channels > 56 || width <= 0 || height <= 0
+            || width > 300000 || height > 300000) {
+        errorString = "Unsupported PSD color mode";
+        return false;
+    }
+
+    //image resources section
+    quint32 resourcesSectionLength;
+    if(!file.seek(26 + 4 + (qint64)colorDataLength))
+        return false;
+
+    stream >> resourcesSectionLength;
+    resourcesOffset = 26 + 4 + (qint64)colorDataLength + 4;
+    resourcesLength = resourcesSectionLength;
+
+    //layer and mask information section, skipped completely
+    const qint64 layerOffset = resourcesOffset + resourcesLength;
+    qint64 layerLength = 0;
+    if(!file.seek(layerOffset))
+        return false;
+
+    if(bigDocument) {
+        quint64 length;
+        stream >> length;
+        layerLength = length;
+    }
+    else {
+        quint32 length;
+        stream >> length;
+        layerLength = length;
+    }
+
+    imageDataOffset = layerOffset + (bigDocument ? 8 : 4) + layerLength;
+
+    if(stream.status() != QDataStream::Ok || layerLength < 0 || imageDataOffset + 2 > file.size()) {
+        errorString = "Corrupt PSD file";
+        return false;
+    }
+
+    return true;
+}
+
+//computes where the data of every row of every channel starts.
+//RLE compressed data starts with a table of the compressed row lengths.
+bool PsdReader::readRowOffsets(int compression, QVector<qint64> &offsets, QVector<quint32> &lengths) {
+    const int rowCount = channels * height;
+    const qint64 rowBytes = (qint64)width * (depth / 8);
+    offsets.resize(rowCount);
+    lengths.resize(rowCount);
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 fileSize = file.size();
+
+    if(compression == 0) {
+        const qint64 dataOffset = imageDataOffset + 2;
+        for(int i = 0; i < rowCount; ++i) {
+            offsets[i] = dataOffset + i * rowBytes;
+            lengths[i] = rowBytes;
+        }
+
+        return dataOffset + rowCount * rowBytes <= fileSize;
+    }
+
+    //2 bytes per row in PSD files, 4 bytes in PSB files
+    const int entrySize = bigDocument ? 4 : 2;
+    if(!file.seek(imageDataOffset + 2))
+        return false;
+
+    const QByteArray table = file.read((qint64)rowCount * entrySize);
+    if(table.size() != rowCount * entrySize)
+        return false;
+
+    const uchar *entry = reinterpret_cast<const uchar*>(table.constData());
+    qint64 offset = imageDataOffset + 2 + table.size();
+    for(int i = 0; i < rowCount; ++i, entry += entrySize) {
+        quint32 length = (entry[0] << 8) | entry[1];
+        if(bigDocument)
+            length = ((quint32)entry[0] << 24) | ((quint32)entry[1] << 16) | ((quint32)entry[2] << 8) | entry[3];
+
+        offsets[i] = offset;
+        lengths[i] = length;
+        offset += length;
+    }
+
+    return offset <= fileSize;
+}
@@ -0,0 +1,54 @@
+#ifndef PSDREADER_H
+#define PSDREADER_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// https://www.adobe.com/devnet-apps/photoshop/fileformatashtml/
+
+//reads the merged image of PSD and PSB files without touching the layers.
+//The rows of the merged image are compressed one by one, so only the rows
+//that are needed are read (with positioned reads) and they are decoded in
+//parallel. Large files can be read at a reduced size by skipping rows and
+//columns, which is much faster than decoding them at full resolution.
+class PsdReader
+{
+public:
+    PsdReader(QString path);
+    bool isValid() const;
+    QSize getSize() const;
+    QString getErrorString() const;
+    QImage readThumbnail();
+    QImage read(QRect rect = QRect(), QSize scaledSize = QSize());
+
+    static bool isPsdFile(QString path);
+
+    enum ColorMode {
+        GRAYSCALE = 1,
+        RGB = 3,
+        CMYK = 4
+    };
+
+private:
+    QString path;
+    QString errorString;
+    bool valid;
+    //PSB files use 64 bit lengths and 32 bit row byte counts
+    bool bigDocument;
+    int channels;
+    int width;
+    int height;
+    int depth;
+    int colorMode;
+    qint64 resourcesOffset;
+    qint64 resourcesLength;
+    qint64 imageDataOffset;
+
+    bool readHeader();
+    bool readRowOffsets(int compression, QVector<qint64> &offsets, QVector<quint32> &lengths);
+};
+
+#endif // PSDREADER_H
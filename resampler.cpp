@@ -0,0 +1,414 @@
+#include "resampler.h"
+
+#include <QThreadPool>
+#include <QVarLengthArray>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//the AVX2 kernel is compiled for the target on its own and only used if the CPU has it
+#if defined(__SSE2__) && defined(__GNUC__) && defined(__x86_64__)
+#define RESAMPLER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+//bits after the point of the fixed point weights
+const int PRECISION = 14;
+
+//the source pixels (along one axis) that make up each pixel of the result
+struct Contributions {
+    QVector<int> first;
+    QVector<int> count;
+    //taps weights per pixel of the result, they add up to 1 << PRECISION
+    QVector<qint16> weights;
+    int taps;
+};
+
+struct Pass {
+    const QImage *source;
+    //destination, bits() must not be called on the worker threads
+    uchar *bits;
+    qptrdiff bytesPerLine;
+    QSize size;
+    const Contributions *contributions;
+    bool premultiplied;
+};
+
+typedef void (*RowFunction)(const Pass &pass, int firstRow, int endRow);
+
+struct RowRange {
+    const Pass *pass;
+    RowFunction function;
+    int first;
+    int end;
+};
+
+}
+
+//half the width of the filter at scale 1
+static double filterSupport(Resampler::Filter filter) {
+    switch(filter) {
+    case Resampler::BOX:
+        return 0.5;
+    case Resampler::BILINEAR:
+        return 1.0;
+    default:
+        return 3.0;
+    }
+}
+
+static double sinc(double x) {
+    if(x == 0.0)
+        return 1.0;
+
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+static double filterValue(Resampler::Filter filter, double x) {
+    switch(filter) {
+    case Resampler::BOX:
+        return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+    case Resampler::BILINEAR:
+        x = std::fabs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+    default:
+        return (x > -3.0 && x < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+}
+
+static Contributions makeContributions(int sourceSize, int destSize, Resampler::Filter filter) {
+    const double scale = (double)sourceSize / destSize;
+    //when reducing, the filter covers scale source pixels per unit
+    const double filterScale = qMax(scale, 1.0);
+    const double support = filterSupport(filter) * filterScale;
+
+    Contributions contributions;
+    contributions.taps = (int)std::ceil(support) * 2 + 1;
+    contributions.first.resize(destSize);
+    contributions.count.resize(destSize);
+    contributions.weights.fill(0, destSize * contributions.taps);
+
+    QVarLengthArray<double, 64> weights(contributions.taps);
+    for(int i = 0; i < destSize; ++i) {
+        const double center = (i + 0.5) * scale;
+        const int first = qMax((int)std::floor(center - support + 0.5), 0);
+        const int end = qMin((int)std::floor(center + support + 0.5), sourceSize);
+        const int count = qBound(1, end - first, contributions.taps);
+
+        double total = 0.0;
+        for(int k = 0; k < count; ++k) {
+            weights[k] = filterValue(filter, (first + k - center + 0.5) / filterScale);
+            total += weights[k];
+        }
+
+        //the rounding error goes to the largest weight, so a flat area stays flat
+        qint16 *fixed = contributions.weights.data() + i * contributions.taps;
+        int sum = 0;
+        int largest = 0;
+        for(int k = 0; k < count; ++k) {
+            fixed[k] = total != 0.0 ? (qint16)qRound(weights[k] / total * (1 << PRECISION)) : 0;
+            sum += fixed[k];
+            if(fixed[k] > fixed[largest])
+                largest = k;
+        }
+        fixed[largest] += (1 << PRECISION) - sum;
+
+        contributions.first[i] = first;
+        contributions.count[i] = count;
+    }
+
+    return contributions;
+}
+
+static inline uchar clampToByte(int value) {
+    value >>= PRECISION;
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+//lanczos overshoots, premultiplied colors must not be larger than their alpha
+static void clampToAlpha(uchar *pixels, int first, int end) {
+    for(int x = first; x < end; ++x) {
+        uchar *pixel = pixels + x * 4;
+        const uchar alpha = pixel[3];
+        pixel[0] = qMin(pixel[0], alpha);
+        pixel[1] = qMin(pixel[1], alpha);
+        pixel[2] = qMin(pixel[2], alpha);
+    }
+}
+
+//one row of the result is made from several pixels of the same source row
+static void resampleHorizontal(const Pass &pass, int firstRow, int endRow) {
+    const Contributions &contributions = *pass.contributions;
+    const int width = pass.size.width();
+
+    for(int y = firstRow; y < endRow; ++y) {
+        const uchar *src = pass.source->constScanLine(y);
+        uchar *dst = pass.bits + y * pass.bytesPerLine;
+
+        for(int x = 0; x < width; ++x) {
+            const uchar *pixels = src + contributions.first[x] * 4;
+            const qint16 *weights = contributions.weights.constData() + x * contributions.taps;
+            const int count = contributions.count[x];
+
+#ifdef __SSE2__
+            //two source pixels per step, their channels interleaved so madd sums up both
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sum = _mm_set1_epi32(1 << (PRECISION - 1));
+            int k = 0;
+            for(; k + 1 < count; k += 2) {
+                const __m128i p0 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixels + k * 4));
+                const __m128i p1 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixels + k * 4 + 4));
+                const __m128i interleaved = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+                const __m128i weight = _mm_set1_epi32((quint16)weights[k] | ((quint32)(quint16)weights[k + 1] << 16));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(interleaved, weight));
+            }
+            if(k < count) {
+                const __m128i p = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixels + k * 4));
+                const __m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero);
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(widened, _mm_set1_epi32((quint16)weights[k])));
+            }
+
+            sum = _mm_srai_epi32(sum, PRECISION);
+            sum = _mm_packs_epi32(sum, sum);
+            *reinterpret_cast<int*>(dst + x * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+#else
+            int sum[4] = { 1 << (PRECISION - 1), 1 << (PRECISION - 1), 1 << (PRECISION - 1), 1 << (PRECISION - 1) };
+            for(int k = 0; k < count; ++k) {
+                for(int c = 0; c < 4; ++c)
+                    sum[c] += pixels[k * 4 + c] * weights[k];
+            }
+
+            for(int c = 0; c < 4; ++c)
+                dst[x * 4 + c] = clampToByte(sum[c]);
+#endif
+        }
+
+        if(pass.premultiplied)
+            clampToAlpha(dst, 0, width);
+    }
+}
+
+//the bytes [from, end) of a row of the result, one byte at a time
+static void resampleVerticalBytes(const uchar * const *rows, const qint16 *weights, int count,
+                                  uchar *dst, int from, int end) {
+    for(int x = from; x < end; ++x) {
+        int sum = 1 << (PRECISION - 1);
+        for(int k = 0; k < count; ++k)
+            sum += rows[k][x] * weights[k];
+
+        dst[x] = clampToByte(sum);
+    }
+}
+
+#ifdef __SSE2__
+//16 bytes (4 pixels) at a time, rows are added up in pairs like in resampleHorizontal()
+static int resampleVerticalSse2(const uchar * const *rows, const qint16 *weights, int count,
+                                uchar *dst, int from, int bytes, bool premultiplied) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+
+    int x = from;
+    for(; x + 16 <= bytes; x += 16) {
+        __m128i sum[4];
+        for(int i = 0; i < 4; ++i)
+            sum[i] = _mm_set1_epi32(1 << (PRECISION - 1));
+
+        for(int k = 0; k < count; k += 2) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + x));
+            const bool pair = k + 1 < count;
+            const __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + x)) : zero;
+            const __m128i weight = _mm_set1_epi32((quint16)weights[k] | (pair ? (quint32)(quint16)weights[k + 1] << 16 : 0));
+
+            const __m128i low = _mm_unpacklo_epi8(a, b);
+            const __m128i high = _mm_unpackhi_epi8(a, b);
+            sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weight));
+            sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weight));
+            sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weight));
+            sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weight));
+        }
+
+        for(int i = 0; i < 4; ++i)
+            sum[i] = _mm_srai_epi32(sum[i], PRECISION);
+
+        __m128i result = _mm_packus_epi16(_mm_packs_epi32(sum[0], sum[1]), _mm_packs_epi32(sum[2], sum[3]));
+
+        if(premultiplied) {
+            //the alpha of every pixel copied into all of its bytes
+            __m128i alpha = _mm_and_si128(result, alphaMask);
+            alpha = _mm_or_si128(alpha, _mm_srli_epi32(alpha, 8));
+            alpha = _mm_or_si128(alpha, _mm_srli_epi32(alpha, 16));
+            result = _mm_min_epu8(result, alpha);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+    }
+
+    return x;
+}
+#endif
+
+#ifdef RESAMPLER_AVX2
+//like resampleVerticalSse2() with 32 bytes. The unpack and pack instructions work
+//within the 128 bit lanes, so each lane is computed exactly like the SSE2 version
+__attribute__((target("avx2")))
+static int resampleVerticalAvx2(const uchar * const *rows, const qint16 *weights, int count,
+                                uchar *dst, int from, int bytes, bool premultiplied) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+
+    int x = from;
+    for(; x + 32 <= bytes; x += 32) {
+        __m256i sum[4];
+        for(int i = 0; i < 4; ++i)
+            sum[i] = _mm256_set1_epi32(1 << (PRECISION - 1));
+
+        for(int k = 0; k < count; k += 2) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x));
+            const bool pair = k + 1 < count;
+            const __m256i b = pair ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + x)) : zero;
+            const __m256i weight = _mm256_set1_epi32((quint16)weights[k] | (pair ? (quint32)(quint16)weights[k + 1] << 16 : 0));
+
+            const __m256i low = _mm256_unpacklo_epi8(a, b);
+            const __m256i high = _mm256_unpackhi_epi8(a, b);
+            sum[0] = _mm256_add_epi32(sum[0], _mm256_madd_epi16(_mm256_unpacklo_epi8(low, zero), weight));
+            sum[1] = _mm256_add_epi32(sum[1], _mm256_madd_epi16(_mm256_unpackhi_epi8(low, zero), weight));
+            sum[2] = _mm256_add_epi32(sum[2], _mm256_madd_epi16(_mm256_unpacklo_epi8(high, zero), weight));
+            sum[3] = _mm256_add_epi32(sum[3], _mm256_madd_epi16(_mm256_unpackhi_epi8(high, zero), weight));
+        }
+
+        for(int i = 0; i < 4; ++i)
+            sum[i] = _mm256_srai_epi32(sum[i], PRECISION);
+
+        __m256i result = _mm256_packus_epi16(_mm256_packs_epi32(sum[0], sum[1]), _mm256_packs_epi32(sum[2], sum[3]));
+
+        if(premultiplied) {
+            __m256i alpha = _mm256_and_si256(result, alphaMask);
+            alpha = _mm256_or_si256(alpha, _mm256_srli_epi32(alpha, 8));
+            alpha = _mm256_or_si256(alpha, _mm256_srli_epi32(alpha, 16));
+            result = _mm256_min_epu8(result, alpha);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), result);
+    }
+
+    return x;
+}
+
+static bool hasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+//one row of the result is made from the same pixels of several source rows
+static void resampleVertical(const Pass &pass, int firstRow, int endRow) {
+    const Contributions &contributions = *pass.contributions;
+    const int bytes = pass.size.width() * 4;
+
+    QVarLengthArray<const uchar*, 64> rows(contributions.taps);
+
+    for(int y = firstRow; y < endRow; ++y) {
+        const int count = contributions.count[y];
+        const qint16 *weights = contributions.weights.constData() + y * contributions.taps;
+        for(int k = 0; k < count; ++k)
+            rows[k] = pass.source->constScanLine(contributions.first[y] + k);
+
+        uchar *dst = pass.bits + y * pass.bytesPerLine;
+        //each kernel returns where it stopped, the next one goes on from there
+        int x = 0;
+#ifdef RESAMPLER_AVX2
+        if(hasAvx2())
+            x = resampleVerticalAvx2(rows.constData(), weights, count, dst, x, bytes, pass.premultiplied);
+#endif
+#ifdef __SSE2__
+        x = resampleVerticalSse2(rows.constData(), weights, count, dst, x, bytes, pass.premultiplied);
+#endif
+        resampleVerticalBytes(rows.constData(), weights, count, dst, x, bytes);
+
+        if(pass.premultiplied)
+            clampToAlpha(dst, x / 4, bytes / 4);
+    }
+}
+
+//runs on the worker threads
+static void runRowRange(const RowRange &range) {
+    range.function(*range.pass, range.first, range.end);
+}
+
+//splits the rows of the result among all cores
+static void runPass(RowFunction function, const Pass &pass) {
+    const int rows = pass.size.height();
+    const int parts = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int step = qMax(8, (rows + parts - 1) / parts);
+
+    QVector<RowRange> ranges;
+    for(int first = 0; first < rows; first += step) {
+        RowRange range = { &pass, function, first, qMin(first + step, rows) };
+        ranges.append(range);
+    }
+
+    QtConcurrent::blockingMap(ranges, runRowRange);
+}
+
+//returns the image resized to exactly size, a null image if it can't be allocated
+QImage Resampler::resize(const QImage &image, QSize size, Filter filter) {
+    if(image.isNull() || size.isEmpty())
+        return QImage();
+
+    const bool premultiplied = image.hasAlphaChannel();
+    const QImage::Format format = premultiplied ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    const QImage source = image.convertToFormat(format);
+
+    if(source.size() == size)
+        return source;
+
+    //the rows are made narrower first, then the columns shorter
+    QImage rows = source;
+    if(size.width() != source.width()) {
+        rows = QImage(size.width(), source.height(), format);
+        if(rows.isNull())
+            return QImage();
+
+        const Contributions contributions = makeContributions(source.width(), size.width(), filter);
+        const Pass pass = { &source, rows.bits(), rows.bytesPerLine(), rows.size(), &contributions, premultiplied };
+        runPass(resampleHorizontal, pass);
+    }
+
+    QImage result = rows;
+    if(size.height() != rows.height()) {
+        result = QImage(size, format);
+        if(result.isNull())
+            return QImage();
+
+        const Contributions contributions = makeContributions(rows.height(), size.height(), filter);
+        const Pass pass = { &rows, result.bits(), result.bytesPerLine(), result.size(), &contributions, premultiplied };
+        runPass(resampleVertical, pass);
+    }
+
+    result.setColorSpace(image.colorSpace());
+    result.setDotsPerMeterX(image.dotsPerMeterX());
+    result.setDotsPerMeterY(image.dotsPerMeterY());
+    for(const QString &key : image.textKeys())
+        result.setText(key, image.text(key));
+
+    return result;
+}
+
+//"box", "bilinear" or "lanczos3", used for the settings
+Resampler::Filter Resampler::getFilter(QString name) {
+    name = name.toLower();
+    if(name == "box")
+        return BOX;
+    if(name == "bilinear")
+        return BILINEAR;
+
+    return LANCZOS3;
+}
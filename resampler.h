@@ -0,0 +1,27 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+//resizes images with a separable filter, first along the rows, then along
+//the columns. The filter is stretched when reducing, so every source pixel
+//contributes to the result (QImage::scaled() gets soft and slow at large
+//reductions). Weights are 14 bit fixed point, the inner loops use SSE2 and
+//AVX2 if the CPU has it, and the rows are split among all cores.
+//Images are resampled as premultiplied ARGB32 (RGB32 without alpha).
+class Resampler
+{
+public:
+    enum Filter {
+        BOX,
+        BILINEAR,
+        LANCZOS3
+    };
+
+    static QImage resize(const QImage &image, QSize size, Filter filter = LANCZOS3);
+    static Filter getFilter(QString name);
+};
+
+#endif // RESAMPLER_H
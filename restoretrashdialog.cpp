@@ -4,13 +4,21 @@
 #include <QProgressDialog>
 #include <iostream>
 
-RestoreTrashDialog::RestoreTrashDialog(QWidget *parent, TrashHandler *trashHandler) :
+//closing is false for the files of a session that didn't end normally,
+//they are shown when the program starts
+RestoreTrashDialog::RestoreTrashDialog(QWidget *parent, TrashHandler *trashHandler, bool closing) :
     QDialog(parent),
     ui(new Ui::RestoreTrashDialog)
 {
     ui->setupUi(this);
     this->trashHandler = trashHandler;
 
+    if(!closing) {
+        setWindowTitle("Trash of the Last Session");
+        ui->pushButton_cancel->setText("Keep");
+        ui->pushButton_deleteAll->setText("Delete All");
+    }
+
     connect(ui->pushButton_restoreFile, SIGNAL(clicked()), this, SLOT(restoreFile()));
     connect(ui->pushButton_openTrashFolder, SIGNAL(clicked()), this, SLOT(openTrashFolder()));
     connect(ui->pushButton_cancel, SIGNAL(clicked()), this, SLOT(reject()));
@@ -26,7 +34,8 @@ RestoreTrashDialog::RestoreTrashDialog(QWidget *parent, TrashHandler *trashHandl
         QPixmap pixmap(file.getUrl().toLocalFile());
         QIcon icon(pixmap.scaledToHeight(128));
 
-        QListWidgetItem *item = new QListWidgetItem(file.getUrl().fileName());
+        //the name in the trash might have a number added
+        QListWidgetItem *item = new QListWidgetItem(file.getOriginalUrl().fileName());
         item->setIcon(icon);
 
         ui->listWidget->addItem(item);
@@ -13,7 +13,7 @@ class RestoreTrashDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit RestoreTrashDialog(QWidget *parent = 0, TrashHandler *trashHandler = 0);
+    explicit RestoreTrashDialog(QWidget *parent = 0, TrashHandler *trashHandler = 0, bool closing = true);
     ~RestoreTrashDialog();
 
 private:
@@ -0,0 +1,113 @@
+#include "savequeue.h"
+#include "imagedecoder.h"
+#include "imageorientation.h"
+
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QSaveFile>
+
+namespace {
+
+//runs on the writer thread
+class SaveJob : public QRunnable
+{
+public:
+    SaveJob(QObject *receiver, QImage image, QString sourcePath, unsigned short orientation,
+            QString path, int quality) :
+        receiver(receiver), image(image), sourcePath(sourcePath), orientation(orientation),
+        path(path), quality(quality)
+    {
+    }
+
+    void run() {
+        QString errorString;
+
+        //images that are only displayed at a reduced resolution are decoded again
+        if(image.isNull() && !sourcePath.isEmpty()) {
+            ImageDecoder decoder(sourcePath);
+            if(!decoder.decode())
+                errorString = decoder.getErrorString();
+
+            image = decoder.getImage();
+        }
+
+        if(errorString.isEmpty() && image.isNull())
+            errorString = "No image";
+
+        if(errorString.isEmpty()) {
+            image = ImageOrientation::apply(image, orientation);
+
+            //the format is chosen by the suffix, like QImage::save() does
+            QSaveFile file(path);
+            QImageWriter writer(&file, QFileInfo(path).suffix().toLower().toLatin1());
+            writer.setQuality(quality);
+
+            if(!file.open(QIODevice::WriteOnly)) {
+                errorString = file.errorString();
+            }
+            else if(!writer.write(image)) {
+                errorString = writer.errorString();
+                file.cancelWriting();
+            }
+            else if(!file.commit()) {
+                errorString = file.errorString();
+            }
+        }
+
+        //released before the next job starts
+        image = QImage();
+
+        QMetaObject::invokeMethod(receiver, "jobFinished", Qt::QueuedConnection,
+                                  Q_ARG(QString, path), Q_ARG(QString, errorString));
+    }
+
+private:
+    QObject *receiver;
+    QImage image;
+    QString sourcePath;
+    unsigned short orientation;
+    QString path;
+    int quality;
+};
+
+}
+
+SaveQueue::SaveQueue(QObject *parent) :
+    QObject(parent)
+{
+    //one writer keeps the order, saving the same file twice ends with the last version
+    pool.setMaxThreadCount(1);
+    pendingCount = 0;
+}
+
+SaveQueue::~SaveQueue() {
+    //the images are not lost when the program is closed right after saving
+    waitForDone();
+}
+
+//saves the image with the orientation applied, quality -1 is the default of the format
+void SaveQueue::save(const QImage &image, unsigned short orientation, QString path, int quality) {
+    pendingCount++;
+    pool.start(new SaveJob(this, image, QString(), orientation, path, quality));
+}
+
+//same for the full resolution of another file, which is decoded on the writer thread
+void SaveQueue::save(QString sourcePath, unsigned short orientation, QString path, int quality) {
+    pendingCount++;
+    pool.start(new SaveJob(this, QImage(), sourcePath, orientation, path, quality));
+}
+
+//images that are not written yet
+int SaveQueue::getPendingCount() const {
+    return pendingCount;
+}
+
+void SaveQueue::waitForDone() {
+    pool.waitForDone();
+}
+
+void SaveQueue::jobFinished(QString path, QString errorString) {
+    pendingCount--;
+    emit saved(path, errorString);
+}
@@ -0,0 +1,40 @@
+#ifndef SAVEQUEUE_H
+#define SAVEQUEUE_H
+
+#include <QImage>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+//saves images in the background, one after the other in the order they
+//were added, so the viewer can move on right away. The queue keeps a
+//shallow copy of the image, which stays the same when the viewer changes
+//its own. Orientation and encoding happen on the writer thread, the file
+//is written to a temporary file that replaces the old one once it is
+//complete (QSaveFile), so nobody sees a half written file and a failed save
+//keeps the old one.
+class SaveQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    SaveQueue(QObject *parent = 0);
+    ~SaveQueue();
+    void save(const QImage &image, unsigned short orientation, QString path, int quality = -1);
+    void save(QString sourcePath, unsigned short orientation, QString path, int quality = -1);
+    int getPendingCount() const;
+    void waitForDone();
+
+signals:
+    //errorString is empty if the file was written
+    void saved(QString path, QString errorString);
+
+private:
+    QThreadPool pool;
+    int pendingCount;
+
+private slots:
+    void jobFinished(QString path, QString errorString);
+};
+
+#endif // SAVEQUEUE_H
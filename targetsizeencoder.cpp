@@ -0,0 +1,150 @@
+#include "targetsizeencoder.h"
+
+#include <QBuffer>
+#include <QImageWriter>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+
+struct Candidate {
+    const QImage *image;
+    QByteArray format;
+    int quality;
+    QByteArray data;
+    QString errorString;
+};
+
+}
+
+//runs on the worker threads
+static void encodeCandidate(Candidate &candidate) {
+    QBuffer buffer(&candidate.data);
+    buffer.open(QIODevice::WriteOnly);
+
+    QImageWriter writer(&buffer, candidate.format);
+    writer.setQuality(candidate.quality);
+    if(!writer.write(*candidate.image)) {
+        candidate.errorString = writer.errorString();
+        candidate.data.clear();
+    }
+}
+
+TargetSizeEncoder::TargetSizeEncoder(QByteArray format, qint64 targetBytes) :
+    format(format),
+    targetBytes(targetBytes)
+{
+    quality = -1;
+    iterations = 0;
+    encodeCount = 0;
+    withinTarget = false;
+}
+
+//returns false if the image could not be encoded at all. If it doesn't fit
+//even at quality 1, that version is kept and isWithinTarget() is false
+bool TargetSizeEncoder::encode(const QImage &image) {
+    if(!supportsFormat(format)) {
+        errorString = "Format has no quality setting";
+        return false;
+    }
+
+    const int threads = qMax(2, QThreadPool::globalInstance()->maxThreadCount());
+
+    //the qualities in [low, high] are not decided yet
+    int low = 1;
+    int high = 100;
+    QByteArray smallest;
+    int smallestQuality = -1;
+
+    while(low <= high) {
+        iterations++;
+
+        //evenly spread over the interval, including both ends
+        QVector<Candidate> candidates;
+        const int count = qMin(threads, high - low + 1);
+        for(int i = 0; i < count; ++i) {
+            Candidate candidate;
+            candidate.image = &image;
+            candidate.format = format;
+            candidate.quality = count > 1 ? low + (high - low) * i / (count - 1) : low;
+            candidates.append(candidate);
+        }
+
+        QtConcurrent::blockingMap(candidates, encodeCandidate);
+        encodeCount += candidates.size();
+
+        //the file size grows with the quality
+        int fitting = -1;
+        int tooLarge = -1;
+        for(int i = 0; i < candidates.size(); ++i) {
+            const Candidate &candidate = candidates.at(i);
+            if(candidate.data.isEmpty()) {
+                errorString = candidate.errorString;
+                return false;
+            }
+
+            if(candidate.data.size() <= targetBytes) {
+                fitting = i;
+            }
+            else if(tooLarge < 0) {
+                tooLarge = i;
+            }
+
+            if(smallestQuality < 0 || candidate.quality < smallestQuality) {
+                smallest = candidate.data;
+                smallestQuality = candidate.quality;
+            }
+        }
+
+        if(fitting >= 0) {
+            data = candidates.at(fitting).data;
+            quality = candidates.at(fitting).quality;
+            withinTarget = true;
+            low = quality + 1;
+        }
+
+        //if not even quality 1 fits, the interval is empty now
+        if(tooLarge >= 0)
+            high = candidates.at(tooLarge).quality - 1;
+    }
+
+    if(!withinTarget) {
+        data = smallest;
+        quality = smallestQuality;
+    }
+
+    return true;
+}
+
+QByteArray TargetSizeEncoder::getData() const {
+    return data;
+}
+
+int TargetSizeEncoder::getQuality() const {
+    return quality;
+}
+
+//rounds of parallel encoding that were needed
+int TargetSizeEncoder::getIterations() const {
+    return iterations;
+}
+
+int TargetSizeEncoder::getEncodeCount() const {
+    return encodeCount;
+}
+
+bool TargetSizeEncoder::isWithinTarget() const {
+    return withinTarget;
+}
+
+QString TargetSizeEncoder::getErrorString() const {
+    return errorString;
+}
+
+//formats whose file size depends on the quality
+bool TargetSizeEncoder::supportsFormat(QByteArray format) {
+    format = format.toLower();
+    return (format == "jpg" || format == "jpeg" || format == "webp")
+            && QImageWriter::supportedImageFormats().contains(format);
+}
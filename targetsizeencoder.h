@@ -0,0 +1,38 @@
+#ifndef TARGETSIZEENCODER_H
+#define TARGETSIZEENCODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+//finds the highest quality at which an image fits into a number of bytes
+//(for JPEG and WebP). Every iteration encodes several qualities of the
+//current interval at once on all cores, into memory, and continues between
+//the best one that fits and the next one that doesn't. With 8 cores the
+//quality is found after 3 iterations.
+class TargetSizeEncoder
+{
+public:
+    TargetSizeEncoder(QByteArray format, qint64 targetBytes);
+    bool encode(const QImage &image);
+    QByteArray getData() const;
+    int getQuality() const;
+    int getIterations() const;
+    int getEncodeCount() const;
+    bool isWithinTarget() const;
+    QString getErrorString() const;
+
+    static bool supportsFormat(QByteArray format);
+
+private:
+    QByteArray format;
+    qint64 targetBytes;
+    QByteArray data;
+    int quality;
+    int iterations;
+    int encodeCount;
+    bool withinTarget;
+    QString errorString;
+};
+
+#endif // TARGETSIZEENCODER_H
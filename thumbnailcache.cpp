@@ -0,0 +1,112 @@
+#include "thumbnailcache.h"
+#include "imagedecoder.h"
+
+#include <QCryptographicHash>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+//the cached thumbnail of the file, null if there is none or the file has changed since
+QImage ThumbnailCache::load(QString path, Size size) {
+    const QFileInfo fileInfo(path);
+    if(!fileInfo.exists())
+        return QImage();
+
+    QImageReader reader(getThumbnailPath(path, size), "PNG");
+    if(!reader.canRead())
+        return QImage();
+
+    //the text chunks are read with the header, the image data only if they match
+    if(reader.text("Thumb::URI") != getUri(path)
+            || reader.text("Thumb::MTime") != QString::number(fileInfo.lastModified().toSecsSinceEpoch()))
+        return QImage();
+
+    return reader.read();
+}
+
+//stores a thumbnail of image, the decoded file at path, and returns it.
+//Images larger than the size are scaled down, smaller ones are stored as they are.
+QImage ThumbnailCache::save(QString path, const QImage &image, Size size) {
+    const QFileInfo fileInfo(path);
+    if(image.isNull() || !fileInfo.exists())
+        return QImage();
+
+    QImage thumbnail = image;
+    if(image.width() > size || image.height() > size)
+        thumbnail = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    //thumbnails of thumbnails are not stored
+    const QString directory = getCacheDirectory();
+    if(fileInfo.absoluteFilePath().startsWith(directory + "/"))
+        return thumbnail;
+
+    const QString sizeDirectory = directory + "/" + getDirectoryName(size);
+    if(!QDir().mkpath(sizeDirectory))
+        return thumbnail;
+
+    //only the user may read the thumbnails
+    QFile::setPermissions(directory, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+    QFile::setPermissions(sizeDirectory, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+
+    thumbnail.setText("Thumb::URI", getUri(path));
+    thumbnail.setText("Thumb::MTime", QString::number(fileInfo.lastModified().toSecsSinceEpoch()));
+    thumbnail.setText("Thumb::Size", QString::number(fileInfo.size()));
+    thumbnail.setText("Software", QCoreApplication::applicationName());
+
+    //other programs must never see a partially written file
+    QSaveFile file(getThumbnailPath(path, size));
+    if(file.open(QIODevice::WriteOnly)) {
+        file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        if(thumbnail.save(&file, "PNG"))
+            file.commit();
+        else
+            file.cancelWriting();
+    }
+
+    return thumbnail;
+}
+
+//the cached thumbnail, or a new one if there is none. Decoding is fast
+//because the decoder only decodes as much as the thumbnail needs.
+QImage ThumbnailCache::get(QString path, Size size) {
+    QImage thumbnail = load(path, size);
+    if(!thumbnail.isNull())
+        return thumbnail;
+
+    ImageDecoder decoder(path, QSize(size, size));
+    if(!decoder.decode())
+        return QImage();
+
+    return save(path, decoder.getImage(), size);
+}
+
+QString ThumbnailCache::getThumbnailPath(QString path, Size size) {
+    const QByteArray hash = QCryptographicHash::hash(getUri(path).toUtf8(), QCryptographicHash::Md5).toHex();
+    return getCacheDirectory() + "/" + getDirectoryName(size) + "/" + QString::fromLatin1(hash) + ".png";
+}
+
+//$XDG_CACHE_HOME/thumbnails, ~/.cache/thumbnails by default
+QString ThumbnailCache::getCacheDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/thumbnails";
+}
+
+//the escaped file:// URI of the absolute path
+QString ThumbnailCache::getUri(QString path) {
+    return QString::fromLatin1(QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath()).toEncoded());
+}
+
+QString ThumbnailCache::getDirectoryName(Size size) {
+    switch(size) {
+    case LARGE:
+        return "large";
+    case X_LARGE:
+        return "x-large";
+    default:
+        return "normal";
+    }
+}
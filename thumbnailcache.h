@@ -0,0 +1,35 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QString>
+
+// https://specifications.freedesktop.org/thumbnail-spec/latest/
+
+//thumbnails stored in ~/.cache/thumbnails as described by the freedesktop
+//thumbnail specification, so they are shared with file managers.
+//Thumbnails are PNGs named after the MD5 of the file's URI, they are only
+//used as long as their Thumb::MTime matches the modification time of the file.
+//Everything reads and writes files, call it on worker threads.
+class ThumbnailCache
+{
+public:
+    //the largest edge of the thumbnails in the size's directory
+    enum Size {
+        NORMAL = 128,
+        LARGE = 256,
+        X_LARGE = 512
+    };
+
+    static QImage load(QString path, Size size = NORMAL);
+    static QImage save(QString path, const QImage &image, Size size = NORMAL);
+    static QImage get(QString path, Size size = NORMAL);
+    static QString getThumbnailPath(QString path, Size size = NORMAL);
+    static QString getCacheDirectory();
+
+private:
+    static QString getUri(QString path);
+    static QString getDirectoryName(Size size);
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,169 @@
+#include "thumbnailmodel.h"
+#include "directoryindex.h"
+#include "thumbnailcache.h"
+
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+
+//loads or creates one thumbnail on a thread of the pool
+class ThumbnailJob : public QRunnable
+{
+public:
+    ThumbnailJob(QObject *receiver, QString path, QSharedPointer<QAtomicInt> cancelled) :
+        receiver(receiver), path(path), cancelled(cancelled)
+    {
+    }
+
+    void run() {
+        //the row was scrolled away while the request was queued
+        if(cancelled->loadRelaxed())
+            return;
+
+        const QImage thumbnail = ThumbnailCache::get(path, ThumbnailCache::NORMAL);
+        QMetaObject::invokeMethod(receiver, "thumbnailLoaded", Qt::QueuedConnection,
+                                  Q_ARG(QString, path), Q_ARG(QImage, thumbnail));
+    }
+
+private:
+    QObject *receiver;
+    QString path;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+}
+
+ThumbnailModel::ThumbnailModel(DirectoryIndex *directoryIndex, QObject *parent) :
+    QAbstractListModel(parent),
+    directoryIndex(directoryIndex)
+{
+    rows = directoryIndex->size();
+
+    //the viewer decodes on the other cores
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
+    //a few screens full of thumbnails, the cost is counted in kilobytes
+    thumbnails.setMaxCost(128 * 1024);
+
+    placeholder = QPixmap(ThumbnailCache::NORMAL, ThumbnailCache::NORMAL);
+    placeholder.fill(QColor(40, 40, 40));
+
+    connect(directoryIndex, SIGNAL(listReplaced()), this, SLOT(listReplaced()));
+    connect(directoryIndex, SIGNAL(filesInserted(int,int)), this, SLOT(filesInserted(int,int)));
+    connect(directoryIndex, SIGNAL(filesRemoved(int,int)), this, SLOT(filesRemoved(int,int)));
+}
+
+ThumbnailModel::~ThumbnailModel() {
+    for(QSharedPointer<QAtomicInt> cancelled : pending)
+        cancelled->storeRelaxed(1);
+
+    pool.waitForDone();
+}
+
+int ThumbnailModel::rowCount(const QModelIndex &parent) const {
+    if(parent.isValid())
+        return 0;
+
+    return rows;
+}
+
+QVariant ThumbnailModel::data(const QModelIndex &index, int role) const {
+    if(!index.isValid() || index.row() >= rows)
+        return QVariant();
+
+    if(role == Qt::DecorationRole) {
+        const QString path = directoryIndex->at(index.row()).toLocalFile();
+        QPixmap *thumbnail = thumbnails.object(path);
+        return thumbnail ? *thumbnail : placeholder;
+    }
+
+    if(role == Qt::ToolTipRole)
+        return QFileInfo(directoryIndex->at(index.row()).toLocalFile()).fileName();
+
+    return QVariant();
+}
+
+//requests the thumbnails of the rows [first, last] and of margin rows on
+//both sides of them. Requests for all other rows are cancelled.
+void ThumbnailModel::setVisibleRange(int first, int last, int margin) {
+    first = qMax(0, first);
+    last = qMin(rows - 1, last);
+    const int start = qMax(0, first - margin);
+    const int end = qMin(rows - 1, last + margin);
+
+    QHash<QString, QSharedPointer<QAtomicInt> >::iterator it = pending.begin();
+    while(it != pending.end()) {
+        const int row = directoryIndex->indexOf(QUrl::fromLocalFile(it.key()));
+        if(row < start || row > end) {
+            it.value()->storeRelaxed(1);
+            it = pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    //visible rows first, then the ones next to them
+    for(int row = first; row <= last; ++row)
+        request(row, 1);
+
+    for(int row = start; row <= end; ++row) {
+        if(row < first || row > last)
+            request(row, 0);
+    }
+}
+
+int ThumbnailModel::getPendingCount() const {
+    return pending.size();
+}
+
+void ThumbnailModel::request(int row, int priority) {
+    const QString path = directoryIndex->at(row).toLocalFile();
+    if(path.isEmpty() || thumbnails.contains(path) || failed.contains(path) || pending.contains(path))
+        return;
+
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    pending.insert(path, cancelled);
+    pool.start(new ThumbnailJob(this, path, cancelled), priority);
+}
+
+//another directory or file queue
+void ThumbnailModel::listReplaced() {
+    beginResetModel();
+    rows = directoryIndex->size();
+    failed.clear();
+    endResetModel();
+}
+
+//only the new rows are added, views keep their scroll position and selection
+void ThumbnailModel::filesInserted(int first, int last) {
+    beginInsertRows(QModelIndex(), first, last);
+    rows += last - first + 1;
+    endInsertRows();
+
+    //a file that failed before may have been written again
+    for(int row = first; row <= last; ++row)
+        failed.remove(directoryIndex->at(row).toLocalFile());
+}
+
+void ThumbnailModel::filesRemoved(int first, int last) {
+    beginRemoveRows(QModelIndex(), first, last);
+    rows -= last - first + 1;
+    endRemoveRows();
+}
+
+void ThumbnailModel::thumbnailLoaded(QString path, QImage thumbnail) {
+    pending.remove(path);
+
+    if(thumbnail.isNull())
+        failed.insert(path);
+    else
+        thumbnails.insert(path, new QPixmap(QPixmap::fromImage(thumbnail)),
+                          qMax(1, (int)(thumbnail.sizeInBytes() / 1024)));
+
+    const int row = directoryIndex->indexOf(QUrl::fromLocalFile(path));
+    if(row >= 0 && row < rows)
+        emit dataChanged(index(row), index(row), QVector<int>() << Qt::DecorationRole);
+}
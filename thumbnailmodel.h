@@ -0,0 +1,53 @@
+#ifndef THUMBNAILMODEL_H
+#define THUMBNAILMODEL_H
+
+#include <QAbstractListModel>
+#include <QAtomicInt>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class DirectoryIndex;
+
+//the images of a DirectoryIndex with their thumbnails, for ThumbnailView.
+//Nothing is loaded for rows the view doesn't show: the view reports the
+//rows around its visible part, their thumbnails are requested from a pool
+//of background threads and requests for rows that were scrolled away are
+//cancelled. Only the most recently used thumbnails are kept in memory.
+class ThumbnailModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    ThumbnailModel(DirectoryIndex *directoryIndex, QObject *parent = 0);
+    ~ThumbnailModel();
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    void setVisibleRange(int first, int last, int margin);
+    int getPendingCount() const;
+
+private:
+    DirectoryIndex *directoryIndex;
+    int rows;
+    QThreadPool pool;
+    QCache<QString, QPixmap> thumbnails;
+    //files without a thumbnail, they are not requested again
+    QSet<QString> failed;
+    //queued and running requests, setting the flag cancels a queued request
+    QHash<QString, QSharedPointer<QAtomicInt> > pending;
+    QPixmap placeholder;
+
+    void request(int row, int priority);
+
+private slots:
+    void listReplaced();
+    void filesInserted(int first, int last);
+    void filesRemoved(int first, int last);
+    void thumbnailLoaded(QString path, QImage thumbnail);
+};
+
+#endif // THUMBNAILMODEL_H
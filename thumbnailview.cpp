@@ -0,0 +1,166 @@
+#include "thumbnailview.h"
+#include "thumbnailmodel.h"
+#include "thumbnailcache.h"
+
+#include <QKeyEvent>
+#include <QScrollBar>
+#include <QWheelEvent>
+
+ThumbnailView::ThumbnailView(QWidget *parent) :
+    QListView(parent)
+{
+    thumbnailModel = 0;
+    gridMode = true;
+
+    //uniform items are laid out without asking the model for their sizes
+    setViewMode(QListView::ListMode);
+    setUniformItemSizes(true);
+    setMovement(QListView::Static);
+    setFlow(QListView::LeftToRight);
+    setResizeMode(QListView::Adjust);
+    setSelectionMode(QAbstractItemView::SingleSelection);
+    setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setIconSize(QSize(ThumbnailCache::NORMAL, ThumbnailCache::NORMAL));
+    setGridSize(QSize(ThumbnailCache::NORMAL + 8, ThumbnailCache::NORMAL + 8));
+    setSpacing(0);
+    setFrameShape(QFrame::NoFrame);
+
+    QPalette palette = this->palette();
+    palette.setColor(QPalette::Base, Qt::black);
+    setPalette(palette);
+
+    requestTimer.setSingleShot(true);
+    requestTimer.setInterval(30);
+    connect(&requestTimer, SIGNAL(timeout()), this, SLOT(requestThumbnails()));
+    connect(this, SIGNAL(clicked(QModelIndex)), this, SLOT(itemClicked(QModelIndex)));
+    connect(this, SIGNAL(activated(QModelIndex)), this, SLOT(itemClicked(QModelIndex)));
+
+    //starts as a filmstrip
+    setGridMode(false);
+}
+
+void ThumbnailView::setThumbnailModel(ThumbnailModel *model) {
+    thumbnailModel = model;
+    setModel(model);
+
+    //new rows may be visible
+    connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), &requestTimer, SLOT(start()));
+    connect(model, SIGNAL(rowsRemoved(QModelIndex,int,int)), &requestTimer, SLOT(start()));
+    connect(model, SIGNAL(modelReset()), &requestTimer, SLOT(start()));
+}
+
+//a single row that scrolls horizontally, or rows that fill the view
+void ThumbnailView::setGridMode(bool grid) {
+    if(grid == gridMode)
+        return;
+
+    gridMode = grid;
+    setWrapping(grid);
+
+    if(grid) {
+        setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+        setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+        setMinimumHeight(0);
+        setMaximumHeight(QWIDGETSIZE_MAX);
+    }
+    else {
+        setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+        setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+        setFixedHeight(gridSize().height() + horizontalScrollBar()->sizeHint().height());
+    }
+
+    if(currentIndex().isValid())
+        scrollTo(currentIndex(), QAbstractItemView::PositionAtCenter);
+
+    requestTimer.start();
+}
+
+bool ThumbnailView::isGridMode() const {
+    return gridMode;
+}
+
+//marks the image that is displayed and scrolls to it
+void ThumbnailView::setCurrentImage(int index) {
+    if(!model() || index < 0 || index >= model()->rowCount())
+        return;
+
+    const QModelIndex modelIndex = model()->index(index, 0);
+    setCurrentIndex(modelIndex);
+    scrollTo(modelIndex, gridMode ? QAbstractItemView::EnsureVisible : QAbstractItemView::PositionAtCenter);
+}
+
+void ThumbnailView::resizeEvent(QResizeEvent *event) {
+    QListView::resizeEvent(event);
+    requestTimer.start();
+}
+
+void ThumbnailView::showEvent(QShowEvent *event) {
+    QListView::showEvent(event);
+    requestTimer.start();
+}
+
+void ThumbnailView::scrollContentsBy(int dx, int dy) {
+    QListView::scrollContentsBy(dx, dy);
+    requestTimer.start();
+}
+
+//the mouse wheel scrolls the filmstrip sideways
+void ThumbnailView::wheelEvent(QWheelEvent *event) {
+    if(!gridMode && event->angleDelta().x() == 0) {
+        QScrollBar *scrollBar = horizontalScrollBar();
+        scrollBar->setValue(scrollBar->value() - event->angleDelta().y() * gridSize().width() / 120);
+        event->accept();
+        return;
+    }
+
+    QListView::wheelEvent(event);
+}
+
+void ThumbnailView::keyPressEvent(QKeyEvent *event) {
+    if(gridMode && event->key() == Qt::Key_Escape) {
+        emit closeRequested();
+        return;
+    }
+
+    QListView::keyPressEvent(event);
+}
+
+//thumbnails are centered in their cells
+void ThumbnailView::initViewItemOption(QStyleOptionViewItem *option) const {
+    QListView::initViewItemOption(option);
+    option->decorationPosition = QStyleOptionViewItem::Top;
+    option->decorationAlignment = Qt::AlignCenter;
+    option->displayAlignment = Qt::AlignCenter;
+}
+
+//all items have the grid size, so the visible rows follow from the scroll position
+void ThumbnailView::requestThumbnails() {
+    if(!thumbnailModel || !isVisible() || thumbnailModel->rowCount() == 0)
+        return;
+
+    const QSize cell = gridSize();
+    const QSize viewportSize = viewport()->size();
+    int first;
+    int last;
+
+    if(gridMode) {
+        const int columns = qMax(1, viewportSize.width() / cell.width());
+        const int top = verticalScrollBar()->value();
+        first = top / cell.height() * columns;
+        last = ((top + viewportSize.height()) / cell.height() + 1) * columns - 1;
+    }
+    else {
+        const int left = horizontalScrollBar()->value();
+        first = left / cell.width();
+        last = (left + viewportSize.width()) / cell.width();
+    }
+
+    //one screen ahead and behind, so short scrolls find their thumbnails ready
+    thumbnailModel->setVisibleRange(first, last, last - first + 1);
+}
+
+void ThumbnailView::itemClicked(const QModelIndex &index) {
+    if(index.isValid())
+        emit imageSelected(index.row());
+}
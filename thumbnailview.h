@@ -0,0 +1,47 @@
+#ifndef THUMBNAILVIEW_H
+#define THUMBNAILVIEW_H
+
+#include <QListView>
+#include <QTimer>
+
+class ThumbnailModel;
+
+//a filmstrip of thumbnails below the image, or a grid of them instead of
+//the image. All items have the same size, so the view only lays out and
+//paints the visible ones and scrolling stays fast in huge folders.
+//Thumbnails are requested for the visible rows once scrolling pauses.
+class ThumbnailView : public QListView
+{
+    Q_OBJECT
+
+public:
+    ThumbnailView(QWidget *parent = 0);
+    void setThumbnailModel(ThumbnailModel *model);
+    void setGridMode(bool grid);
+    bool isGridMode() const;
+    void setCurrentImage(int index);
+
+protected:
+    void resizeEvent(QResizeEvent *event);
+    void showEvent(QShowEvent *event);
+    void scrollContentsBy(int dx, int dy);
+    void wheelEvent(QWheelEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+    void initViewItemOption(QStyleOptionViewItem *option) const;
+
+private:
+    ThumbnailModel *thumbnailModel;
+    bool gridMode;
+    //requests thumbnails once scrolling pauses
+    QTimer requestTimer;
+
+private slots:
+    void requestThumbnails();
+    void itemClicked(const QModelIndex &index);
+
+signals:
+    void imageSelected(int index);
+    void closeRequested();
+};
+
+#endif // THUMBNAILVIEW_H
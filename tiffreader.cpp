@@ -0,0 +1,207 @@
+#include "tiffreader.h"
+
+TiffReader::TiffReader(QString path) :
+    file(path)
+{
+    bigEndian = false;
+    valid = false;
+
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    //byte order (2 bytes), magic number 42 (2 bytes), offset of the first directory (4 bytes)
+    QByteArray header = file.read(8);
+    if(header.size() != 8)
+        return;
+
+    if(header.startsWith("II"))
+        bigEndian = false;
+    else if(header.startsWith("MM"))
+        bigEndian = true;
+    else
+        return;
+
+    const uchar *data = reinterpret_cast<const uchar*>(header.constData());
+    if(toUnsignedShort(data + 2) != 42)
+        return;
+
+    valid = readDirectory(toUnsignedLong(data + 4))
+            && value(IMAGE_WIDTH) > 0 && value(IMAGE_LENGTH) > 0;
+}
+
+bool TiffReader::isValid() const {
+    return valid;
+}
+
+QSize TiffReader::getSize() const {
+    return QSize(value(IMAGE_WIDTH), value(IMAGE_LENGTH));
+}
+
+//size of the strips or tiles the image data is stored in.
+//Every decoder has to decode a block as a whole.
+QSize TiffReader::getBlockSize() const {
+    if(!valid)
+        return QSize();
+
+    if(tags.contains(TILE_WIDTH) && tags.contains(TILE_LENGTH))
+        return QSize(value(TILE_WIDTH), value(TILE_LENGTH));
+
+    //a single strip if the tag is missing
+    return QSize(value(IMAGE_WIDTH), qMin(value(ROWS_PER_STRIP, value(IMAGE_LENGTH)), value(IMAGE_LENGTH)));
+}
+
+//true for uncompressed 8 bit gray, RGB and RGBA strips
+bool TiffReader::canReadRegion() const {
+    if(!valid || value(COMPRESSION, 1) != 1 || value(PLANAR_CONFIGURATION, 1) != 1)
+        return false;
+
+    if(tags.contains(TILE_WIDTH) || !tags.contains(STRIP_OFFSETS) || getBlockSize().height() <= 0)
+        return false;
+
+    for(quint32 bits : tags.value(BITS_PER_SAMPLE)) {
+        if(bits != 8)
+            return false;
+    }
+
+    const quint32 samples = value(SAMPLES_PER_PIXEL, 1);
+    const quint32 photometric = value(PHOTOMETRIC);
+    return (samples == 1 && photometric == 1) || ((samples == 3 || samples == 4) && photometric == 2);
+}
+
+//reads the given part of the image. Only the rows of the region are read
+//from the file, returns a null image on errors.
+QImage TiffReader::readRegion(QRect rect) {
+    rect &= QRect(QPoint(0, 0), getSize());
+    if(!canReadRegion() || rect.isEmpty())
+        return QImage();
+
+    const quint32 samples = value(SAMPLES_PER_PIXEL, 1);
+    QImage::Format format = QImage::Format_Grayscale8;
+    if(samples == 3)
+        format = QImage::Format_RGB888;
+    else if(samples == 4)
+        format = value(EXTRA_SAMPLES) == 1 ? QImage::Format_RGBA8888_Premultiplied : QImage::Format_RGBA8888;
+
+    QImage region(rect.size(), format);
+    if(region.isNull())
+        return QImage();
+
+    const QVector<quint32> &stripOffsets = tags[STRIP_OFFSETS];
+    const quint32 rowsPerStrip = getBlockSize().height();
+    const qint64 rowBytes = (qint64)value(IMAGE_WIDTH) * samples;
+    const qint64 regionRowBytes = (qint64)rect.width() * samples;
+
+    for(int y = 0; y < rect.height(); ++y) {
+        const quint32 row = rect.top() + y;
+        const int strip = row / rowsPerStrip;
+        if(strip >= stripOffsets.size())
+            return QImage();
+
+        const qint64 offset = stripOffsets.at(strip) + (row % rowsPerStrip) * rowBytes + (qint64)rect.left() * samples;
+        if(!file.seek(offset))
+            return QImage();
+
+        if(file.read(reinterpret_cast<char*>(region.scanLine(y)), regionRowBytes) != regionRowBytes)
+            return QImage();
+    }
+
+    return region;
+}
+
+bool TiffReader::isBigEndian() const {
+    return bigEndian;
+}
+
+bool TiffReader::hasTag(quint16 tag) const {
+    return tags.contains(tag);
+}
+
+//all values of the tag, empty if the first directory doesn't have it
+QVector<quint32> TiffReader::getValues(quint16 tag) const {
+    return tags.value(tag);
+}
+
+bool TiffReader::readDirectory(quint32 offset) {
+    if(!file.seek(offset))
+        return false;
+
+    QByteArray countBytes = file.read(2);
+    if(countBytes.size() != 2)
+        return false;
+
+    //every entry is 12 bytes: tag, type, count and the value or an offset to it
+    const int count = toUnsignedShort(reinterpret_cast<const uchar*>(countBytes.constData()));
+    QByteArray entries = file.read(count * 12);
+    if(entries.size() != count * 12)
+        return false;
+
+    for(int i = 0; i < count; ++i) {
+        const uchar *entry = reinterpret_cast<const uchar*>(entries.constData()) + i * 12;
+        const quint16 tag = toUnsignedShort(entry);
+        const quint16 type = toUnsignedShort(entry + 2);
+        const quint32 valueCount = toUnsignedLong(entry + 4);
+
+        //only BYTE, SHORT and LONG values are needed, UNDEFINED is read as bytes
+        int size = 0;
+        if(type == 1 || type == 7)
+            size = 1;
+        else if(type == 3)
+            size = 2;
+        else if(type == 4)
+            size = 4;
+
+        if(size == 0 || valueCount == 0 || valueCount > (1 << 24))
+            continue;
+
+        //values that fit into 4 bytes are stored in the entry itself
+        QByteArray external;
+        const uchar *data = entry + 8;
+        if(valueCount * size > 4) {
+            if(!file.seek(toUnsignedLong(entry + 8)))
+                continue;
+
+            external = file.read(valueCount * size);
+            if(external.size() != (int)(valueCount * size))
+                continue;
+
+            data = reinterpret_cast<const uchar*>(external.constData());
+        }
+
+        QVector<quint32> values(valueCount);
+        for(quint32 j = 0; j < valueCount; ++j) {
+            if(size == 1)
+                values[j] = data[j];
+            else if(size == 2)
+                values[j] = toUnsignedShort(data + j * 2);
+            else
+                values[j] = toUnsignedLong(data + j * 4);
+        }
+
+        tags.insert(tag, values);
+    }
+
+    return true;
+}
+
+//first value of the tag
+quint32 TiffReader::value(Tag tag, quint32 defaultValue) const {
+    QHash<quint16, QVector<quint32> >::const_iterator it = tags.constFind(tag);
+    if(it == tags.constEnd() || it->isEmpty())
+        return defaultValue;
+
+    return it->first();
+}
+
+quint16 TiffReader::toUnsignedShort(const uchar *data) const {
+    if(bigEndian)
+        return (data[0] << 8) | data[1];
+
+    return data[0] | (data[1] << 8);
+}
+
+quint32 TiffReader::toUnsignedLong(const uchar *data) const {
+    if(bigEndian)
+        return ((quint32)data[0] << 24) | ((quint32)data[1] << 16) | ((quint32)data[2] << 8) | data[3];
+
+    return data[0] | ((quint32)data[1] << 8) | ((quint32)data[2] << 16) | ((quint32)data[3] << 24);
+}
@@ -0,0 +1,65 @@
+#ifndef TIFFREADER_H
+#define TIFFREADER_H
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// https://www.adobe.io/content/dam/udp/en/open/standards/tiff/TIFF6.pdf
+
+//reads the layout of the first image in a TIFF file.
+//Uncompressed 8 bit strips can be read directly from the file, row by row,
+//so a region of a huge scan is decoded without touching the rest of it.
+class TiffReader
+{
+public:
+    TiffReader(QString path);
+    bool isValid() const;
+    QSize getSize() const;
+    QSize getBlockSize() const;
+    bool canReadRegion() const;
+    QImage readRegion(QRect rect);
+    bool isBigEndian() const;
+    bool hasTag(quint16 tag) const;
+    QVector<quint32> getValues(quint16 tag) const;
+
+    enum Tag {
+        IMAGE_WIDTH = 256,
+        IMAGE_LENGTH = 257,
+        BITS_PER_SAMPLE = 258,
+        COMPRESSION = 259,
+        PHOTOMETRIC = 262,
+        FILL_ORDER = 266,
+        STRIP_OFFSETS = 273,
+        SAMPLES_PER_PIXEL = 277,
+        ROWS_PER_STRIP = 278,
+        STRIP_BYTE_COUNTS = 279,
+        PLANAR_CONFIGURATION = 284,
+        PREDICTOR = 317,
+        TILE_WIDTH = 322,
+        TILE_LENGTH = 323,
+        TILE_OFFSETS = 324,
+        TILE_BYTE_COUNTS = 325,
+        EXTRA_SAMPLES = 338,
+        SAMPLE_FORMAT = 339,
+        ICC_PROFILE = 34675
+    };
+
+private:
+    QFile file;
+    bool bigEndian;
+    bool valid;
+    //values of the tags of the first image file directory
+    QHash<quint16, QVector<quint32> > tags;
+
+    bool readDirectory(quint32 offset);
+    quint32 value(Tag tag, quint32 defaultValue = 0) const;
+    quint16 toUnsignedShort(const uchar *data) const;
+    quint32 toUnsignedLong(const uchar *data) const;
+};
+
+#endif // TIFFREADER_H
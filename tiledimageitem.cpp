@@ -0,0 +1,236 @@
+#include "tiledimageitem.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//the full image and its downscaled copies, shared with the worker threads
+class ImagePyramid
+{
+public:
+    ImagePyramid(const QImage &image, int levelCount) :
+        levels(levelCount),
+        built(new std::once_flag[levelCount])
+    {
+        levels[0] = image;
+    }
+
+    //returns the image at the given level, each level has half the size of
+    //the previous one. A missing level is generated once from the previous
+    //one, threads that need the same level wait for it, others don't.
+    QImage level(int index) {
+        if(index > 0) {
+            std::call_once(built[index], [this, index]() {
+                const QImage previous = level(index - 1);
+                levels[index] = previous.scaled(qMax(1, previous.width() / 2), qMax(1, previous.height() / 2),
+                                                Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            });
+        }
+
+        return levels[index];
+    }
+
+    void cancel() {
+        cancelled.storeRelaxed(1);
+    }
+
+    bool isCancelled() const {
+        return cancelled.loadRelaxed() != 0;
+    }
+
+private:
+    //each element is only written once, inside the call_once of its level
+    std::vector<QImage> levels;
+    std::unique_ptr<std::once_flag[]> built;
+    QAtomicInt cancelled;
+};
+
+//tiles wait for each other while a level is generated, so they get their
+//own threads instead of blocking the global pool the decoders run on
+static QThreadPool* getTilePool() {
+    static QThreadPool pool;
+    return &pool;
+}
+
+//runs on the worker threads
+static QImage renderTile(QSharedPointer<ImagePyramid> pyramid, int level, QRect rect) {
+    //the image is not displayed anymore
+    if(pyramid->isCancelled())
+        return QImage();
+
+    return pyramid->level(level).copy(rect);
+}
+
+TiledImageItem::TiledImageItem(const QImage &image, QGraphicsItem *parent) :
+    QGraphicsObject(parent),
+    source(image)
+{
+    //needed to get the exposed rect in paint()
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
+    //level sizes are known in advance, the levels are generated when needed
+    QSize size = image.size();
+    levelSizes.append(size);
+    while(size.width() > tileSize || size.height() > tileSize) {
+        size = QSize(qMax(1, size.width() / 2), qMax(1, size.height() / 2));
+        levelSizes.append(size);
+    }
+
+    pyramid = QSharedPointer<ImagePyramid>(new ImagePyramid(image, levelSizes.size()));
+
+    tiles.setMaxCost(256 * 1024);
+}
+
+TiledImageItem::~TiledImageItem() {
+    //don't generate tiles that nobody will look at
+    pyramid->cancel();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+    return QRectF(0, 0, source.width(), source.height());
+}
+
+void TiledImageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(widget);
+
+    const QRectF exposed = option->exposedRect & boundingRect();
+    if(exposed.isEmpty())
+        return;
+
+    //use the smallest level that still has at least one pixel per screen pixel
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    int level = 0;
+    while(level < levelSizes.size() - 1 && lod * (1 << (level + 1)) <= 1.0)
+        level++;
+
+    //turn off AA when zooming in beyond 100%, like the pixmap item
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, lod * (1 << level) < 2.0);
+
+    const QSize levelSize = levelSizes.at(level);
+    const double scaleX = (double)source.width() / levelSize.width();
+    const double scaleY = (double)source.height() / levelSize.height();
+
+    const int firstX = qMax(0, (int)(exposed.left() / scaleX / tileSize));
+    const int lastX = qMin((levelSize.width() - 1) / tileSize, (int)(exposed.right() / scaleX / tileSize));
+    const int firstY = qMax(0, (int)(exposed.top() / scaleY / tileSize));
+    const int lastY = qMin((levelSize.height() - 1) / tileSize, (int)(exposed.bottom() / scaleY / tileSize));
+
+    for(int y = firstY; y <= lastY; ++y) {
+        for(int x = firstX; x <= lastX; ++x) {
+            const QRectF target = tileRectInItem(level, x, y);
+
+            //the pointer is only valid until the next tile is inserted
+            QPixmap *tile = getTile(level, x, y);
+            if(tile)
+                painter->drawPixmap(target, *tile, QRectF(tile->rect()));
+            else
+                drawFallback(painter, level, target);
+        }
+    }
+}
+
+//large images are displayed by this item instead of a QGraphicsPixmapItem
+bool TiledImageItem::isSuitable(const QImage &image) {
+    return (qint64)image.width() * image.height() > 4096 * 4096;
+}
+
+quint64 TiledImageItem::tileKey(int level, int x, int y) {
+    return ((quint64)level << 56) | ((quint64)x << 28) | (quint64)y;
+}
+
+QRect TiledImageItem::tileRectInLevel(int level, int x, int y) const {
+    return QRect(x * tileSize, y * tileSize, tileSize, tileSize) & QRect(QPoint(0, 0), levelSizes.at(level));
+}
+
+QRectF TiledImageItem::tileRectInItem(int level, int x, int y) const {
+    const QRect rect = tileRectInLevel(level, x, y);
+    const double scaleX = (double)source.width() / levelSizes.at(level).width();
+    const double scaleY = (double)source.height() / levelSizes.at(level).height();
+
+    return QRectF(rect.x() * scaleX, rect.y() * scaleY, rect.width() * scaleX, rect.height() * scaleY);
+}
+
+//returns the rasterized tile or 0 if it is not available yet
+QPixmap* TiledImageItem::getTile(int level, int x, int y) {
+    const quint64 key = tileKey(level, x, y);
+
+    QPixmap *tile = tiles.object(key);
+    if(tile)
+        return tile;
+
+    if(level > 0) {
+        requestTile(level, x, y);
+        return 0;
+    }
+
+    //full resolution tiles are just a copy of a part of the image
+    QPixmap pixmap = QPixmap::fromImage(source.copy(tileRectInLevel(0, x, y)));
+    const int cost = qMax(1, pixmap.width() * pixmap.height() * 4 / 1024);
+    if(!tiles.insert(key, new QPixmap(pixmap), cost))
+        return 0;
+
+    return tiles.object(key);
+}
+
+void TiledImageItem::requestTile(int level, int x, int y) {
+    const quint64 key = tileKey(level, x, y);
+    if(pendingTiles.contains(key))
+        return;
+
+    pendingTiles.insert(key);
+
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    watcher->setProperty("tileKey", QVariant((qulonglong)key));
+    connect(watcher, SIGNAL(finished()), this, SLOT(tileFinished()));
+    watcher->setFuture(QtConcurrent::run(getTilePool(), renderTile, pyramid, level, tileRectInLevel(level, x, y)));
+}
+
+//draws the matching part of a coarser tile while the right one is generated
+void TiledImageItem::drawFallback(QPainter *painter, int level, const QRectF &target) {
+    for(int coarser = level + 1; coarser < levelSizes.size(); ++coarser) {
+        const QSize levelSize = levelSizes.at(coarser);
+        const double scaleX = (double)source.width() / levelSize.width();
+        const double scaleY = (double)source.height() / levelSize.height();
+
+        const int x = qMin((levelSize.width() - 1) / tileSize, (int)(target.center().x() / scaleX / tileSize));
+        const int y = qMin((levelSize.height() - 1) / tileSize, (int)(target.center().y() / scaleY / tileSize));
+
+        QPixmap *tile = tiles.object(tileKey(coarser, x, y));
+        if(!tile)
+            continue;
+
+        const QRectF tileRect = tileRectInItem(coarser, x, y);
+        const QRectF sourceRect((target.left() - tileRect.left()) / scaleX,
+                                (target.top() - tileRect.top()) / scaleY,
+                                target.width() / scaleX,
+                                target.height() / scaleY);
+        painter->drawPixmap(target, *tile, sourceRect);
+        return;
+    }
+}
+
+void TiledImageItem::tileFinished() {
+    QFutureWatcher<QImage> *watcher = static_cast<QFutureWatcher<QImage>*>(sender());
+    const quint64 key = watcher->property("tileKey").toULongLong();
+    const QImage image = watcher->result();
+    watcher->deleteLater();
+
+    pendingTiles.remove(key);
+    if(image.isNull())
+        return;
+
+    const int cost = qMax(1, image.width() * image.height() * 4 / 1024);
+    tiles.insert(key, new QPixmap(QPixmap::fromImage(image)), cost);
+
+    const int level = (int)(key >> 56);
+    const int x = (int)((key >> 28) & 0xFFFFFFF);
+    const int y = (int)(key & 0xFFFFFFF);
+    update(tileRectInItem(level, x, y));
+}
@@ -0,0 +1,50 @@
+#ifndef TILEDIMAGEITEM_H
+#define TILEDIMAGEITEM_H
+
+#include <QGraphicsObject>
+#include <QImage>
+#include <QPixmap>
+#include <QCache>
+#include <QSet>
+#include <QSharedPointer>
+
+class ImagePyramid;
+
+//displays a large image as square tiles instead of one huge pixmap.
+//When zoomed out, tiles are taken from downscaled copies of the image
+//(mip levels) which are generated lazily on worker threads. Only the
+//tiles intersecting the exposed area are rasterized.
+class TiledImageItem : public QGraphicsObject
+{
+    Q_OBJECT
+
+public:
+    TiledImageItem(const QImage &image, QGraphicsItem *parent = 0);
+    ~TiledImageItem();
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+
+    static bool isSuitable(const QImage &image);
+
+    static const int tileSize = 256;
+
+private:
+    QSharedPointer<ImagePyramid> pyramid;
+    QImage source;
+    QList<QSize> levelSizes;
+    //rasterized tiles, the cost is counted in kilobytes
+    QCache<quint64, QPixmap> tiles;
+    QSet<quint64> pendingTiles;
+
+    static quint64 tileKey(int level, int x, int y);
+    QRect tileRectInLevel(int level, int x, int y) const;
+    QRectF tileRectInItem(int level, int x, int y) const;
+    QPixmap* getTile(int level, int x, int y);
+    void requestTile(int level, int x, int y);
+    void drawFallback(QPainter *painter, int level, const QRectF &target);
+
+private slots:
+    void tileFinished();
+};
+
+#endif // TILEDIMAGEITEM_H
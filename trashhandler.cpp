@@ -1,67 +1,380 @@
 #include "trashhandler.h"
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <QUuid>
+#include <QtConcurrent/QtConcurrentRun>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#endif
+
 #include <iostream>
 
 TrashHandler::TrashHandler()
 {
+    dataPath = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/imagepreview";
+    QDir().mkpath(dataPath + "/trash");
+
+    //held until the program ends, other instances leave the journal alone
+    journalPath = dataPath + "/trash-" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".journal";
+    journalLock = new QLockFile(journalPath + ".lock");
+    journalLock->setStaleLockTime(0);
+    journalLock->tryLock(0);
+
+    movePool.setMaxThreadCount(1);
+
+    //files of sessions that didn't end normally
+    adoptJournals();
+}
+
+TrashHandler::~TrashHandler() {
+    //a file is not left half copied
+    waitForMoves();
+
+    //a journal that is left behind is taken over by the next start
+    delete journalLock;
 }
 
 bool TrashHandler::moveToTrash(QUrl url) {
-    if(!trashDir.isValid()) {
+    const QString path = url.toLocalFile();
+    if(!QFileInfo::exists(path) || pendingMoves.contains(path))
         return false;
-    }
 
-    QUrl trashUrl = QUrl::fromLocalFile(trashDir.path() + "/" + url.fileName());
-    TrashedFile trashedFile(url, trashUrl);
-    trash.append(trashedFile);
-
-    QFile file(url.toLocalFile());
-    if(file.exists()) {
-        file.rename(trashUrl.toLocalFile());
+    //the file is renamed into the trash on its file system. If that fails,
+    //it is copied into the trash in the home folder, which is on another one
+    PendingMove move;
+    const QString trashDirectory = getTrashDirectory(path);
+    if(!trashDirectory.isEmpty()) {
+        move.trashPaths.append(getUniquePath(trashDirectory, url.fileName()));
+        reservedPaths.insert(move.trashPaths.last());
     }
-    else {
-        return false;
+    if(trashDirectory != dataPath + "/trash") {
+        move.trashPaths.append(getUniquePath(dataPath + "/trash", url.fileName()));
+        reservedPaths.insert(move.trashPaths.last());
     }
 
+    //written before the file is moved, entries whose file never arrived are ignored
+    for(const QString &trashPath : move.trashPaths)
+        writeJournal("trash", url, QUrl::fromLocalFile(trashPath));
+
+    //deleting doesn't wait for the disk, the entry gets its final name in waitForMoves()
+    move.future = QtConcurrent::run(&movePool, moveToTrashDirectory, journalPath, path, move.trashPaths);
+    pendingMoves.insert(path, move);
+    trash.append(TrashedFile(url, QUrl::fromLocalFile(move.trashPaths.first())));
     return true;
 }
 
+//names of the files before they were deleted
 QStringList TrashHandler::getFileNames() {
     QStringList fileNames;
 
     for(int i = 0; i < trash.size(); i++) {
-        fileNames.append(trash.at(i).getUrl().fileName());
+        fileNames.append(trash.at(i).getOriginalUrl().fileName());
     }
 
     return fileNames;
 }
 
 const QList<TrashedFile> TrashHandler::getFiles() {
+    waitForMoves();
     return trash;
 }
 
 bool TrashHandler::restore(int index) {
+    waitForMoves();
+
     if(index < 0 || index >= trash.size())
         return false;
 
     TrashedFile trashedFile = trash.at(index);
+    const QString path = trashedFile.getUrl().toLocalFile();
+    const QString originalPath = trashedFile.getOriginalUrl().toLocalFile();
 
-    QFile file(trashedFile.getUrl().toLocalFile());
-    if(file.exists()) {
-        file.rename(trashedFile.getOriginalUrl().toLocalFile());
-    }
-    else {
+    //neither replaces a file that was created in the meantime
+    if(!renameFile(path, originalPath) && !moveFile(path, originalPath))
         return false;
-    }
 
+    writeJournal("restore", trashedFile.getUrl());
     trash.removeAt(index);
     return true;
 }
 
+//deletes the files in the trash for good
+void TrashHandler::emptyTrash() {
+    waitForMoves();
+
+    QSet<QString> directories;
+    for(const TrashedFile &trashedFile : trash) {
+        const QString path = trashedFile.getUrl().toLocalFile();
+        QFile::remove(path);
+        directories.insert(QFileInfo(path).absolutePath());
+        writeJournal("purge", trashedFile.getUrl());
+    }
+    trash.clear();
+
+    //trash folders next to images are not left behind, the others are kept
+    for(const QString &directory : directories)
+        QDir().rmdir(directory);
+
+    QFile::remove(journalPath);
+}
+
 bool TrashHandler::isEmpty() {
     return trash.size() == 0;
 }
 
+//folder of the file that was deleted last
 QUrl TrashHandler::getTrashUrl() {
-    return QUrl::fromLocalFile(trashDir.path());
+    waitForMoves();
+
+    if(trash.isEmpty())
+        return QUrl::fromLocalFile(dataPath + "/trash");
+
+    return trash.last().getUrl().adjusted(QUrl::RemoveFilename);
+}
+
+//trash folder on the same file system as path, empty if none can be created
+QString TrashHandler::getTrashDirectory(QString path) {
+    const QString directory = QFileInfo(path).absolutePath();
+    if(trashDirectories.contains(directory))
+        return trashDirectories.value(directory);
+
+    const QStorageInfo volume(directory);
+    QString trashDirectory;
+
+    if(!volume.isValid()) {
+        trashDirectory = QString();
+    }
+    else if(volume == QStorageInfo(dataPath)) {
+        trashDirectory = dataPath + "/trash";
+    }
+    else {
+        //like the trash of the desktop, a hidden folder per user at the top of the volume
+        QString name = ".imagepreview-trash";
+#ifdef Q_OS_UNIX
+        name += "-" + QString::number(getuid());
+#endif
+        trashDirectory = QDir(volume.rootPath()).filePath(name);
+
+        //the top of the volume might not be writable, but the folder of the image is
+        if(!QDir().mkpath(trashDirectory)) {
+            trashDirectory = QDir(directory).filePath(".imagepreview-trash");
+            if(!QDir().mkpath(trashDirectory))
+                trashDirectory = QString();
+        }
+    }
+
+    trashDirectories.insert(directory, trashDirectory);
+    return trashDirectory;
+}
+
+//appends one line, the urls are encoded so they contain no spaces or line breaks:
+//  trash <original url> <trash url>
+//  restore <trash url>
+//  purge <trash url>
+void TrashHandler::writeJournal(QByteArray action, QUrl url, QUrl trashUrl) {
+    QByteArray line = action + " " + url.toEncoded();
+    if(trashUrl.isValid())
+        line += " " + trashUrl.toEncoded();
+    line += "\n";
+
+    //without the journal the files can still be restored, just not after a crash.
+    //The move syncs it to the disk before it starts, off the GUI thread
+    QFile journal(journalPath);
+    if(journal.open(QIODevice::WriteOnly | QIODevice::Append))
+        journal.write(line);
+}
+
+//takes over the journals of sessions that didn't end normally. Journals of
+//running instances are locked, the lock of a crashed one is stale. Their
+//files are written into the own journal before the old one is removed.
+void TrashHandler::adoptJournals() {
+    const QDir directory(dataPath);
+    const QStringList names = directory.entryList(QStringList() << "trash*.journal", QDir::Files);
+
+    for(const QString &name : names) {
+        const QString path = directory.filePath(name);
+        if(path == journalPath)
+            continue;
+
+        QLockFile lock(path + ".lock");
+        lock.setStaleLockTime(0);
+        if(!lock.tryLock(0))
+            continue;
+
+        //files that were never moved into the trash are not listed
+        for(const TrashedFile &entry : readJournal(path)) {
+            if(QFileInfo::exists(entry.getUrl().toLocalFile()))
+                trash.append(entry);
+        }
+
+        QSaveFile compacted(journalPath);
+        if(!compacted.open(QIODevice::WriteOnly))
+            continue;
+
+        for(const TrashedFile &entry : trash)
+            compacted.write("trash " + entry.getOriginalUrl().toEncoded() + " " + entry.getUrl().toEncoded() + "\n");
+
+        if(compacted.commit())
+            QFile::remove(path);
+    }
+}
+
+//the files the journal lists as in the trash
+QList<TrashedFile> TrashHandler::readJournal(QString path) {
+    QList<TrashedFile> entries;
+
+    QFile journal(path);
+    if(!journal.open(QIODevice::ReadOnly))
+        return entries;
+
+    while(!journal.atEnd()) {
+        //a line that was cut off by a crash doesn't match
+        const QList<QByteArray> fields = journal.readLine().trimmed().split(' ');
+        if(fields.size() == 3 && fields.at(0) == "trash") {
+            const QUrl trashUrl = QUrl::fromEncoded(fields.at(2));
+            for(int i = entries.size() - 1; i >= 0; --i) {
+                if(entries.at(i).getUrl() == trashUrl)
+                    entries.removeAt(i);
+            }
+            entries.append(TrashedFile(QUrl::fromEncoded(fields.at(1)), trashUrl));
+        }
+        else if(fields.size() == 2 && (fields.at(0) == "restore" || fields.at(0) == "purge")) {
+            const QUrl trashUrl = QUrl::fromEncoded(fields.at(1));
+            for(int i = entries.size() - 1; i >= 0; --i) {
+                if(entries.at(i).getUrl() == trashUrl)
+                    entries.removeAt(i);
+            }
+        }
+    }
+
+    return entries;
+}
+
+//waits for the files that are copied into the trash. The ones that
+//couldn't be copied are still where they were, they leave the trash
+void TrashHandler::waitForMoves() {
+    for(const QString &path : pendingMoves.keys()) {
+        PendingMove move = pendingMoves.value(path);
+        const QString trashPath = move.future.result();
+
+        //a file is only in one pending move, and it is the last entry for it
+        const QUrl url = QUrl::fromLocalFile(path);
+        for(int i = trash.size() - 1; i >= 0; --i) {
+            if(trash.at(i).getOriginalUrl() == url && trash.at(i).getUrl().toLocalFile() == move.trashPaths.first()) {
+                if(trashPath.isEmpty())
+                    trash.removeAt(i);
+                else
+                    trash.replace(i, TrashedFile(url, QUrl::fromLocalFile(trashPath)));
+                break;
+            }
+        }
+
+        //the names that were not used leave the journal
+        for(const QString &unused : move.trashPaths) {
+            if(unused != trashPath)
+                writeJournal("restore", QUrl::fromLocalFile(unused));
+        }
+    }
+
+    pendingMoves.clear();
+    reservedPaths.clear();
+}
+
+//a name in the folder that is not taken yet, an image deleted twice keeps both versions.
+//Names of files that are still being copied into the trash are taken too
+QString TrashHandler::getUniquePath(QString directory, QString fileName) const {
+    const QFileInfo fileInfo(fileName);
+    QString path = QDir(directory).filePath(fileName);
+
+    for(int i = 2; QFileInfo::exists(path) || reservedPaths.contains(path); ++i) {
+        const QString suffix = fileInfo.suffix().isEmpty() ? "" : "." + fileInfo.suffix();
+        path = QDir(directory).filePath(fileInfo.completeBaseName() + " (" + QString::number(i) + ")" + suffix);
+    }
+
+    return path;
+}
+
+//runs on the thread of the move pool, returns the trash path the file got
+QString TrashHandler::moveToTrashDirectory(QString journalPath, QString path, QStringList trashPaths) {
+    syncJournal(journalPath);
+
+    for(const QString &trashPath : trashPaths) {
+        if(renameFile(path, trashPath))
+            return trashPath;
+    }
+
+    //the last one is the trash in the home folder, which may be on another file system
+    if(moveFile(path, trashPaths.last()))
+        return trashPaths.last();
+
+    return QString();
+}
+
+//the lines of the journal reach the disk before the move that follows them
+void TrashHandler::syncJournal(QString journalPath) {
+    QFile journal(journalPath);
+    if(!journal.open(QIODevice::WriteOnly | QIODevice::Append))
+        return;
+
+#ifdef Q_OS_UNIX
+    fsync(journal.handle());
+#endif
+#ifdef Q_OS_WIN
+    _commit(journal.handle());
+#endif
+}
+
+//renames a file on the same file system. Unlike QFile::rename() and
+//QDir::rename() it fails instead of copying, and never replaces a file
+bool TrashHandler::renameFile(QString path, QString newPath) {
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(path).utf16()),
+                       reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(newPath).utf16()), 0);
+#else
+    const QByteArray source = QFile::encodeName(path);
+    const QByteArray target = QFile::encodeName(newPath);
+
+#ifdef RENAME_NOREPLACE
+    if(renameat2(AT_FDCWD, source.constData(), AT_FDCWD, target.constData(), RENAME_NOREPLACE) == 0)
+        return true;
+
+    //only file systems without support for the flag are checked below
+    if(errno != EINVAL && errno != ENOSYS)
+        return false;
+#endif
+
+    if(QFileInfo::exists(newPath))
+        return false;
+
+    return ::rename(source.constData(), target.constData()) == 0;
+#endif
+}
+
+//moves a file to another file system. QFile::copy() writes a temporary
+//file first, so there is never a partial file under the new name
+bool TrashHandler::moveFile(QString path, QString newPath) {
+    if(!QFile::copy(path, newPath))
+        return false;
+
+    if(!QFile::remove(path)) {
+        QFile::remove(newPath);
+        return false;
+    }
+
+    return true;
 }
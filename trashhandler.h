@@ -1,25 +1,70 @@
 #ifndef TRASHHANDLER_H
 #define TRASHHANDLER_H
 
+#include <QFuture>
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <QThreadPool>
 #include <QUrl>
-#include <QTemporaryDir>
 #include "trashedfile.h"
 
+class QLockFile;
+
+//deleted images are kept until the program is closed, so they can be
+//restored. They are moved into a trash folder on the same file system
+//(one per volume, or next to the image if the top of the volume is not
+//writable), which is a rename that takes the same time for any file size.
+//Only if that fails they are copied into the trash in the home folder.
+//The moves run in the background, one after the other. Every move is
+//written to a journal before it happens, so after a crash the files of
+//the last session can still be restored. Each process has its own journal,
+//journals are only taken over once the process that wrote them is gone.
 class TrashHandler
 {
 public:
     TrashHandler();
+    ~TrashHandler();
     bool moveToTrash(QUrl url);
     QStringList getFileNames();
     const QList<TrashedFile> getFiles();
     bool restore(int index);
+    void emptyTrash();
     bool isEmpty();
     QUrl getTrashUrl();
 
 private:
+    struct PendingMove {
+        //the names the file may get, in the order they are tried
+        QStringList trashPaths;
+        //the name it got, empty if it couldn't be moved
+        QFuture<QString> future;
+    };
+
     QList<TrashedFile> trash;
-    QTemporaryDir trashDir;
+    //path of the file -> its move
+    QHash<QString, PendingMove> pendingMoves;
+    //trash paths of the pending moves, which don't exist until they are done
+    QSet<QString> reservedPaths;
+    //the moves run in order, each after the journal lines before it are on the disk
+    QThreadPool movePool;
+    //folder of an image -> trash folder on its file system
+    QHash<QString, QString> trashDirectories;
+    //the trash in the home folder and the journals
+    QString dataPath;
+    QString journalPath;
+    QLockFile *journalLock;
+
+    QString getTrashDirectory(QString path);
+    void writeJournal(QByteArray action, QUrl url, QUrl trashUrl = QUrl());
+    void adoptJournals();
+    static QList<TrashedFile> readJournal(QString path);
+    void waitForMoves();
+    QString getUniquePath(QString directory, QString fileName) const;
+    static QString moveToTrashDirectory(QString journalPath, QString path, QStringList trashPaths);
+    static void syncJournal(QString journalPath);
+    static bool renameFile(QString path, QString newPath);
+    static bool moveFile(QString path, QString newPath);
 };
 
 #endif // TRASHHANDLER_H